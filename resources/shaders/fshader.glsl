@@ -2,10 +2,22 @@
 
 in vec3 v_normal;
 in vec3 v_position;
+in vec3 v_color;
+noperspective in vec3 v_barycentric;
 out vec4 fragColor;
 
 uniform int  u_flatMode;   // 1 = ignore lighting, output u_flatColor
 uniform vec3 u_flatColor;
+uniform int  u_wireframe;  // 1 = draw facet edges only
+uniform int  u_deriveNormals; // 1 = no normal attribute, use flat normals
+
+// Return 1.0 on a facet edge, fading to 0.0 about 1.5 pixels inside.
+float edgeIntensity()
+{
+    vec3 width = fwidth(v_barycentric);
+    vec3 inside = smoothstep(vec3(0.0), width * 1.5, v_barycentric);
+    return 1.0 - min(min(inside.x, inside.y), inside.z);
+}
 
 void main()
 {
@@ -14,9 +26,24 @@ void main()
         return;
     }
 
+    float edge = edgeIntensity();
+    if (u_wireframe == 1 && edge <= 0.0)
+        discard;
+
     // Light direction in view space (from above-right-front)
     vec3 lightDir = normalize(vec3(1.0, 1.0, 2.0));
-    vec3 normal = normalize(v_normal);
+    vec3 normal;
+    if (u_deriveNormals == 1) {
+        // Flat facet normal from the screen-space derivatives of the
+        // view-space position, oriented towards the viewer.
+        normal = normalize(cross(dFdx(v_position), dFdy(v_position)));
+        if (normal.z < 0.0)
+            normal = -normal;
+    } else {
+        normal = normalize(v_normal);
+        if (!gl_FrontFacing)
+            normal = -normal;
+    }
 
     // Ambient
     vec3 ambient = vec3(0.15, 0.15, 0.15);
@@ -31,9 +58,18 @@ void main()
     float spec = pow(max(dot(normal, halfDir), 0.0), 32.0);
     vec3 specular = spec * vec3(0.3, 0.3, 0.3);
 
-    // Object color (steel blue-grey)
-    vec3 objectColor = vec3(0.6, 0.65, 0.7);
+    // Object or part color; visible back faces usually mean an open mesh
+    // or flipped facets, so tint them and outline their edges.
+    vec3 objectColor = v_color;
+    if (!gl_FrontFacing)
+        objectColor = vec3(0.8, 0.4, 0.35);
 
     vec3 result = (ambient + diffuse + specular) * objectColor;
-    fragColor = vec4(result, 1.0);
+
+    if (u_wireframe == 1)
+        fragColor = vec4(result, edge);
+    else if (!gl_FrontFacing)
+        fragColor = vec4(mix(result, vec3(0.1, 0.1, 0.1), edge), 1.0);
+    else
+        fragColor = vec4(result, 1.0);
 }
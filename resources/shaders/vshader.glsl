@@ -1,17 +1,47 @@
 #version 330 core
 
-in vec3 a_position;
-in vec3 a_normal;
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec3 a_normal;
+layout(location = 2) in float a_part;
+uniform vec3 u_positionOffset;  // a_position is normalized to the bounding
+uniform vec3 u_positionScale;   // box; these map it back to model space
+uniform int u_scene;            // 1 = offset, scale, color and transform
+uniform samplerBuffer u_parts;  // come from the part table instead
 uniform mat3 normalMatrix;
 uniform mat4 modelViewMatrix;
 uniform mat4 projectionMatrix;
 out vec3 v_normal;
 out vec3 v_position;
+out vec3 v_color;
+noperspective out vec3 v_barycentric;
 
 void main()
 {
-    v_normal = normalize(normalMatrix * a_normal);
-    vec4 pos = modelViewMatrix * vec4(a_position, 1.0);
+    vec3 offset = u_positionOffset;
+    vec3 scale = u_positionScale;
+    mat4 partMatrix = mat4(1.0);
+    v_color = vec3(0.6, 0.65, 0.7);  // steel blue-grey
+    if (u_scene == 1) {
+        // Six texels per part, see GeometryEngine::partBuf.
+        int base = int(a_part) * 6;
+        offset = texelFetch(u_parts, base).xyz;
+        scale = texelFetch(u_parts, base + 1).xyz;
+        v_color = texelFetch(u_parts, base + 2).rgb;
+        partMatrix = transpose(mat4(texelFetch(u_parts, base + 3),
+                                    texelFetch(u_parts, base + 4),
+                                    texelFetch(u_parts, base + 5),
+                                    vec4(0.0, 0.0, 0.0, 1.0)));
+    }
+
+    v_normal = normalize(normalMatrix * mat3(partMatrix) * a_normal);
+    vec3 position = offset + a_position * scale;
+    vec4 pos = modelViewMatrix * partMatrix * vec4(position, 1.0);
     v_position = pos.xyz;
     gl_Position = projectionMatrix * pos;
+
+    // Triangles are not indexed, so the corner of the facet follows from the
+    // vertex index.  The rasterizer interpolates these into barycentric
+    // coordinates, which the fragment shader uses to find the edges.
+    int corner = gl_VertexID % 3;
+    v_barycentric = vec3(corner == 0, corner == 1, corner == 2);
 }
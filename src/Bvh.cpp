@@ -0,0 +1,571 @@
+// Copyright (C) 2009-2015 Olivier Crave
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "Bvh.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+using namespace stlviewer;
+
+namespace
+{
+    // Bins per axis over which the surface area heuristic is evaluated.
+    const int BIN_COUNT = 16;
+
+    // Cost of visiting a node, relative to intersecting one triangle.
+    const float TRAVERSAL_COST = 1.0f;
+
+    // Larger nodes are split even if the heuristic prefers a leaf.
+    const std::uint32_t MAX_LEAF_SIZE = 8;
+
+    // Larger nodes are binned in parallel and their halves are built as
+    // separate tasks.
+    const std::size_t PARALLEL_SIZE = 1 << 16;
+
+    const std::size_t GRAIN_SIZE = 1 << 14;
+
+    struct Box
+    {
+        float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+        void grow(const float _p[3])
+        {
+            for (int a = 0; a < 3; ++a)
+            {
+                this->min[a] = std::min(this->min[a], _p[a]);
+                this->max[a] = std::max(this->max[a], _p[a]);
+            }
+        }
+
+        void grow(const Box &_box)
+        {
+            for (int a = 0; a < 3; ++a)
+            {
+                this->min[a] = std::min(this->min[a], _box.min[a]);
+                this->max[a] = std::max(this->max[a], _box.max[a]);
+            }
+        }
+
+        float area() const
+        {
+            const float dx = this->max[0] - this->min[0];
+            const float dy = this->max[1] - this->min[1];
+            const float dz = this->max[2] - this->min[2];
+            if (dx < 0 || dy < 0 || dz < 0)
+                return 0.0f;
+            return 2.0f * (dx * dy + dy * dz + dz * dx);
+        }
+    };
+
+    struct Bin
+    {
+        Box bounds;
+        Box centroids;
+        std::uint32_t count = 0;
+    };
+
+    struct Binning
+    {
+        Bin bins[3][BIN_COUNT];
+
+        void merge(const Binning &_other)
+        {
+            for (int a = 0; a < 3; ++a)
+            {
+                for (int k = 0; k < BIN_COUNT; ++k)
+                {
+                    this->bins[a][k].bounds.grow(_other.bins[a][k].bounds);
+                    this->bins[a][k].centroids.grow(_other.bins[a][k].centroids);
+                    this->bins[a][k].count += _other.bins[a][k].count;
+                }
+            }
+        }
+    };
+
+    struct Split
+    {
+        int axis = -1;
+        int bin = 0;
+        float cost = FLT_MAX;
+        Box leftBounds;
+        Box leftCentroids;
+        Box rightBounds;
+        Box rightCentroids;
+    };
+
+    Box boundsOf(const Bvh::Triangle &_t)
+    {
+        Box box;
+        for (const Vector &v : _t.vertex)
+        {
+            const float p[3] = { v.x, v.y, v.z };
+            box.grow(p);
+        }
+        return box;
+    }
+
+    void centerOf(const Box &_box, float _center[3])
+    {
+        for (int a = 0; a < 3; ++a)
+            _center[a] = 0.5f * (_box.min[a] + _box.max[a]);
+    }
+
+    // Bin of _center along _axis. Binning and partitioning must agree, so
+    // both go through here. NaN coordinates end up in the first bin.
+    int binOf(const float _center[3], int _axis, const Box &_centroids)
+    {
+        const float extent = _centroids.max[_axis] - _centroids.min[_axis];
+        const float f = (_center[_axis] - _centroids.min[_axis]) * (BIN_COUNT / extent);
+        if (!(f > 0.0f))
+            return 0;
+        return f < BIN_COUNT ? static_cast<int>(f) : BIN_COUNT - 1;
+    }
+
+    Vector sub(const Vector &_a, const Vector &_b)
+    {
+        return Vector(_a.x - _b.x, _a.y - _b.y, _a.z - _b.z);
+    }
+
+    Vector cross(const Vector &_a, const Vector &_b)
+    {
+        return Vector(_a.y * _b.z - _a.z * _b.y,
+                      _a.z * _b.x - _a.x * _b.z,
+                      _a.x * _b.y - _a.y * _b.x);
+    }
+
+    float dot(const Vector &_a, const Vector &_b)
+    {
+        return _a.x * _b.x + _a.y * _b.y + _a.z * _b.z;
+    }
+
+    // Möller-Trumbore; both sides of the facet are hit.
+    // \return The ray parameter, or a negative value on a miss.
+    float intersectTriangle(const Bvh::Triangle &_t, const Vector &_origin,
+                            const Vector &_direction)
+    {
+        const Vector e1 = sub(_t.vertex[1], _t.vertex[0]);
+        const Vector e2 = sub(_t.vertex[2], _t.vertex[0]);
+        const Vector p = cross(_direction, e2);
+        const float det = dot(e1, p);
+        if (det == 0.0f)
+            return -1.0f;
+        const float inv = 1.0f / det;
+        const Vector s = sub(_origin, _t.vertex[0]);
+        const float u = dot(s, p) * inv;
+        if (u < 0.0f || u > 1.0f)
+            return -1.0f;
+        const Vector q = cross(s, e1);
+        const float v = dot(_direction, q) * inv;
+        if (v < 0.0f || u + v > 1.0f)
+            return -1.0f;
+        return dot(e2, q) * inv;
+    }
+}
+
+class Bvh::Builder
+{
+    public: Builder(const std::vector<Triangle> &_triangles,
+                    const CancellationToken &_token)
+        : triangles(_triangles)
+        , order(_triangles.size())
+        , token(_token)
+    {
+    }
+
+    public: void build(std::vector<Node> &_nodes, std::vector<std::uint32_t> &_order)
+    {
+        std::iota(this->order.begin(), this->order.end(), 0u);
+        const std::uint32_t count = static_cast<std::uint32_t>(this->order.size());
+        Box bounds, centroids;
+        this->computeBounds(0, count, bounds, centroids);
+        _nodes.reserve(count / 2);
+        this->buildNode(0, count, bounds, centroids, _nodes);
+        _order.swap(this->order);
+    }
+
+    /// \brief Append the subtree over order[_begin, _end) to _nodes.
+    private: void buildNode(std::uint32_t _begin, std::uint32_t _end,
+                            const Box &_bounds, const Box &_centroids,
+                            std::vector<Node> &_nodes)
+    {
+        if (this->token.isCancelled())
+            return;
+
+        const std::size_t index = _nodes.size();
+        Node node;
+        std::copy(_bounds.min, _bounds.min + 3, node.min);
+        std::copy(_bounds.max, _bounds.max + 3, node.max);
+        node.index = _begin;
+        node.count = _end - _begin;
+        _nodes.push_back(node);
+
+        const std::uint32_t count = _end - _begin;
+        if (count == 1)
+            return;
+
+        Split split;
+        std::uint32_t mid;
+        if (this->findSplit(_begin, _end, _bounds, _centroids, split))
+        {
+            if (split.cost >= count && count <= MAX_LEAF_SIZE)
+                return;
+            mid = static_cast<std::uint32_t>(std::partition(
+                this->order.begin() + _begin, this->order.begin() + _end,
+                [&](std::uint32_t _i) {
+                    float center[3];
+                    centerOf(boundsOf(this->triangles[_i]), center);
+                    return binOf(center, split.axis, _centroids) < split.bin;
+                }) - this->order.begin());
+        }
+        else
+        {
+            // All centroids coincide, so no plane separates them.
+            if (count <= MAX_LEAF_SIZE)
+                return;
+            mid = _begin + count / 2;
+            this->computeBounds(_begin, mid, split.leftBounds, split.leftCentroids);
+            this->computeBounds(mid, _end, split.rightBounds, split.rightCentroids);
+        }
+
+        _nodes[index].count = 0;
+        if (count > PARALLEL_SIZE)
+        {
+            std::vector<Node> right;
+            TaskGroup group(this->token);
+            group.run([&]() {
+                this->buildNode(mid, _end, split.rightBounds, split.rightCentroids, right);
+            });
+            this->buildNode(_begin, mid, split.leftBounds, split.leftCentroids, _nodes);
+            group.wait();
+
+            // The right subtree was numbered from 0.
+            const std::uint32_t offset = static_cast<std::uint32_t>(_nodes.size());
+            _nodes[index].index = offset;
+            for (Node &n : right)
+            {
+                if (n.count == 0)
+                    n.index += offset;
+            }
+            _nodes.insert(_nodes.end(), right.begin(), right.end());
+        }
+        else
+        {
+            this->buildNode(_begin, mid, split.leftBounds, split.leftCentroids, _nodes);
+            _nodes[index].index = static_cast<std::uint32_t>(_nodes.size());
+            this->buildNode(mid, _end, split.rightBounds, split.rightCentroids, _nodes);
+        }
+    }
+
+    /// \brief Find the cheapest split of order[_begin, _end) that leaves
+    /// triangles on both sides.
+    private: bool findSplit(std::uint32_t _begin, std::uint32_t _end,
+                            const Box &_bounds, const Box &_centroids,
+                            Split &_split) const
+    {
+        Binning binning;
+        const std::size_t count = _end - _begin;
+        if (count > PARALLEL_SIZE)
+        {
+            const std::size_t blocks = (count + GRAIN_SIZE - 1) / GRAIN_SIZE;
+            std::vector<Binning> partial(blocks);
+            parallelFor(0, blocks, 1, [&](std::size_t _b, std::size_t _e) {
+                for (std::size_t k = _b; k < _e; ++k)
+                {
+                    const std::size_t first = _begin + k * GRAIN_SIZE;
+                    const std::size_t last = std::min<std::size_t>(_end, first + GRAIN_SIZE);
+                    this->binRange(first, last, _centroids, partial[k]);
+                }
+            }, this->token);
+            for (const Binning &p : partial)
+                binning.merge(p);
+        }
+        else
+        {
+            this->binRange(_begin, _end, _centroids, binning);
+        }
+
+        float best = FLT_MAX;
+        for (int a = 0; a < 3; ++a)
+        {
+            const Bin *bins = binning.bins[a];
+
+            // Area and count of the right side of a split before bin k.
+            float rightArea[BIN_COUNT];
+            std::uint32_t rightCount[BIN_COUNT];
+            Box right;
+            std::uint32_t n = 0;
+            for (int k = BIN_COUNT - 1; k > 0; --k)
+            {
+                right.grow(bins[k].bounds);
+                n += bins[k].count;
+                rightArea[k] = right.area();
+                rightCount[k] = n;
+            }
+
+            Box left;
+            n = 0;
+            for (int k = 1; k < BIN_COUNT; ++k)
+            {
+                left.grow(bins[k - 1].bounds);
+                n += bins[k - 1].count;
+                if (n == 0 || rightCount[k] == 0)
+                    continue;
+                const float cost = n * left.area() + rightCount[k] * rightArea[k];
+                if (cost < best)
+                {
+                    best = cost;
+                    _split.axis = a;
+                    _split.bin = k;
+                }
+            }
+        }
+        if (_split.axis < 0)
+            return false;
+
+        for (int k = 0; k < BIN_COUNT; ++k)
+        {
+            const Bin &bin = binning.bins[_split.axis][k];
+            Box &bounds = k < _split.bin ? _split.leftBounds : _split.rightBounds;
+            Box &centroids = k < _split.bin ? _split.leftCentroids : _split.rightCentroids;
+            bounds.grow(bin.bounds);
+            centroids.grow(bin.centroids);
+        }
+        _split.cost = TRAVERSAL_COST + best / std::max(_bounds.area(), FLT_MIN);
+        return true;
+    }
+
+    private: void binRange(std::size_t _begin, std::size_t _end,
+                           const Box &_centroids, Binning &_binning) const
+    {
+        for (std::size_t i = _begin; i < _end; ++i)
+        {
+            const Box box = boundsOf(this->triangles[this->order[i]]);
+            float center[3];
+            centerOf(box, center);
+            for (int a = 0; a < 3; ++a)
+            {
+                if (!(_centroids.max[a] > _centroids.min[a]))
+                    continue;
+                Bin &bin = _binning.bins[a][binOf(center, a, _centroids)];
+                bin.bounds.grow(box);
+                bin.centroids.grow(center);
+                ++bin.count;
+            }
+        }
+    }
+
+    private: void computeBounds(std::size_t _begin, std::size_t _end,
+                                Box &_bounds, Box &_centroids) const
+    {
+        const std::size_t blocks = (_end - _begin + GRAIN_SIZE - 1) / GRAIN_SIZE;
+        std::vector<Box> bounds(blocks), centroids(blocks);
+        parallelFor(0, blocks, 1, [&](std::size_t _b, std::size_t _e) {
+            for (std::size_t k = _b; k < _e; ++k)
+            {
+                const std::size_t last = std::min(_end, _begin + (k + 1) * GRAIN_SIZE);
+                for (std::size_t i = _begin + k * GRAIN_SIZE; i < last; ++i)
+                {
+                    const Box box = boundsOf(this->triangles[this->order[i]]);
+                    float center[3];
+                    centerOf(box, center);
+                    bounds[k].grow(box);
+                    centroids[k].grow(center);
+                }
+            }
+        }, this->token);
+        for (std::size_t k = 0; k < blocks; ++k)
+        {
+            _bounds.grow(bounds[k]);
+            _centroids.grow(centroids[k]);
+        }
+    }
+
+    private: const std::vector<Triangle> &triangles;
+
+    /// \brief Triangle indices, partitioned in place as nodes are split.
+    private: std::vector<std::uint32_t> order;
+
+    private: CancellationToken token;
+};
+
+Bvh::Bvh()
+{
+}
+
+bool Bvh::build(std::vector<Triangle> _triangles, const CancellationToken &_token)
+{
+    this->nodes.clear();
+    this->triangles.clear();
+    this->facets.clear();
+    if (_triangles.empty())
+        return !_token.isCancelled();
+
+    std::vector<Node> tree;
+    std::vector<std::uint32_t> order;
+    Builder(_triangles, _token).build(tree, order);
+    if (_token.isCancelled())
+        return false;
+
+    // Store the triangles in leaf order.
+    this->triangles.resize(_triangles.size());
+    parallelFor(0, order.size(), GRAIN_SIZE, [&](std::size_t _b, std::size_t _e) {
+        for (std::size_t i = _b; i < _e; ++i)
+            this->triangles[i] = _triangles[order[i]];
+    });
+    tree.shrink_to_fit();
+    this->nodes.swap(tree);
+    this->facets.swap(order);
+    return true;
+}
+
+std::size_t Bvh::memoryBytes() const
+{
+    return this->nodes.capacity() * sizeof(Node) +
+        this->triangles.capacity() * sizeof(Triangle) +
+        this->facets.capacity() * sizeof(std::uint32_t);
+}
+
+bool Bvh::intersect(const Vector &_origin, const Vector &_direction,
+                    float _maxDistance, Hit &_hit) const
+{
+    if (this->nodes.empty())
+        return false;
+
+    const float origin[3] = { _origin.x, _origin.y, _origin.z };
+    // Division by zero gives infinities, which the slab test handles.
+    const float inv[3] = { 1.0f / _direction.x, 1.0f / _direction.y,
+                           1.0f / _direction.z };
+
+    // Ray parameter at which the ray enters _node, or a miss.
+    auto enter = [&](const Node &_node, float _limit, float &_t) {
+        float t0 = 0.0f;
+        float t1 = _limit;
+        for (int a = 0; a < 3; ++a)
+        {
+            float tNear = (_node.min[a] - origin[a]) * inv[a];
+            float tFar = (_node.max[a] - origin[a]) * inv[a];
+            if (tNear > tFar)
+                std::swap(tNear, tFar);
+            t0 = std::max(t0, tNear);
+            t1 = std::min(t1, tFar);
+        }
+        _t = t0;
+        return t0 <= t1;
+    };
+
+    struct Entry
+    {
+        std::uint32_t node;
+        float t;
+    };
+    std::vector<Entry> stack;
+    stack.reserve(64);
+
+    float best = _maxDistance;
+    std::size_t bestTriangle = this->triangles.size();
+    float t;
+    if (enter(this->nodes[0], best, t))
+        stack.push_back({ 0, t });
+
+    while (!stack.empty())
+    {
+        const Entry entry = stack.back();
+        stack.pop_back();
+        if (entry.t > best)
+            continue;
+
+        const Node &node = this->nodes[entry.node];
+        if (node.count > 0)
+        {
+            for (std::uint32_t i = node.index; i < node.index + node.count; ++i)
+            {
+                const float d = intersectTriangle(this->triangles[i], _origin, _direction);
+                if (d >= 0.0f && d <= best)
+                {
+                    best = d;
+                    bestTriangle = i;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first.
+        const std::uint32_t left = entry.node + 1;
+        const std::uint32_t right = node.index;
+        float tLeft, tRight;
+        const bool hitLeft = enter(this->nodes[left], best, tLeft);
+        const bool hitRight = enter(this->nodes[right], best, tRight);
+        if (hitLeft && hitRight)
+        {
+            if (tLeft <= tRight)
+            {
+                stack.push_back({ right, tRight });
+                stack.push_back({ left, tLeft });
+            }
+            else
+            {
+                stack.push_back({ left, tLeft });
+                stack.push_back({ right, tRight });
+            }
+        }
+        else if (hitLeft)
+        {
+            stack.push_back({ left, tLeft });
+        }
+        else if (hitRight)
+        {
+            stack.push_back({ right, tRight });
+        }
+    }
+
+    if (bestTriangle == this->triangles.size())
+        return false;
+
+    const Triangle &triangle = this->triangles[bestTriangle];
+    _hit.facet = static_cast<int>(this->facets[bestTriangle]);
+    _hit.distance = best;
+    _hit.point = Vector(_origin.x + best * _direction.x,
+                        _origin.y + best * _direction.y,
+                        _origin.z + best * _direction.z);
+
+    Vector normal = cross(sub(triangle.vertex[1], triangle.vertex[0]),
+                          sub(triangle.vertex[2], triangle.vertex[0]));
+    const float length = std::sqrt(dot(normal, normal));
+    if (length > 0.0f)
+        normal = Vector(normal.x / length, normal.y / length, normal.z / length);
+    _hit.normal = normal;
+
+    float nearest = FLT_MAX;
+    for (const Vector &v : triangle.vertex)
+    {
+        const Vector d = sub(v, _hit.point);
+        if (dot(d, d) < nearest)
+        {
+            nearest = dot(d, d);
+            _hit.vertex = v;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,115 @@
+// Copyright (C) 2009-2015 Olivier Crave
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef _BVH_HPP
+#define _BVH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vector.h"
+#include "TaskScheduler.hpp"
+
+namespace stlviewer
+{
+
+/// \brief Bounding volume hierarchy over the facets of a mesh, for ray
+/// queries such as picking.
+///
+/// The tree is built top-down. Each node is split where the surface area
+/// heuristic, evaluated over a fixed number of bins on every axis, is
+/// lowest. Large nodes are binned in parallel and their two halves are
+/// built as separate tasks. Nodes are stored depth-first in one array and
+/// the triangles are reordered to match the leaves, so that a query reads
+/// contiguous memory.
+class Bvh
+{
+    public: struct Triangle
+    {
+        Vector vertex[3];
+    };
+
+    public: struct Hit
+    {
+        /// \brief Index of the facet in the file, -1 if nothing was hit.
+        int facet = -1;
+
+        /// \brief Ray parameter of the hit: the point is
+        /// origin + distance * direction.
+        float distance = 0.f;
+
+        Vector point;
+
+        /// \brief Unit normal of the facet, from its winding.
+        Vector normal;
+
+        /// \brief Corner of the facet closest to point.
+        Vector vertex;
+    };
+
+    public: Bvh();
+
+    /// \brief Build the tree over _triangles, where _triangles[i] is facet
+    /// i of the file. Replaces any previous tree.
+    /// \return False if _token was cancelled; the tree is then empty.
+    public: bool build(::std::vector<Triangle> _triangles,
+                       const CancellationToken &_token = CancellationToken());
+
+    public: bool isEmpty() const { return this->nodes.empty(); }
+
+    public: int getTriangleCount() const
+            { return static_cast<int>(this->triangles.size()); }
+
+    /// \brief Return the memory held by the tree, in bytes.
+    public: ::std::size_t memoryBytes() const;
+
+    /// \brief Find the closest facet hit by the ray
+    /// _origin + t * _direction, with t in [0, _maxDistance]. _direction
+    /// need not be normalized.
+    public: bool intersect(const Vector &_origin, const Vector &_direction,
+                           float _maxDistance, Hit &_hit) const;
+
+    /// \brief A leaf when count > 0: triangles [index, index + count).
+    /// Otherwise the left child follows the node and index is the right
+    /// child.
+    private: struct Node
+    {
+        float min[3];
+        float max[3];
+        ::std::uint32_t index;
+        ::std::uint32_t count;
+    };
+
+    private: class Builder;
+
+    private: ::std::vector<Node> nodes;
+
+    /// \brief Triangles in leaf order.
+    private: ::std::vector<Triangle> triangles;
+
+    /// \brief File index of each triangle.
+    private: ::std::vector<::std::uint32_t> facets;
+};
+
+}
+
+#endif
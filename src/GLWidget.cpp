@@ -29,51 +29,87 @@ using namespace stlviewer;
 
 bool GLWidget::yAxisReversed = false;
 
+bool GLWidget::derivedNormals = true;
+
+// Delay after the last mouse event before the full mesh is drawn again.
+static const int REFINE_DELAY_MS = 300;
+
 GLWidget::GLWidget(QWidget *_parent)
     : QOpenGLWidget(_parent)
-    , stlfile(nullptr)
     , width(0)
     , height(0)
     , wireframeMode(false)
+    , interacting(false)
     , leftMouseButtonMode(INACTIVE)
     , rot()
     , pos()
     , zoomFactor(1.0)
     , zoomInc(0)
     , defaultZoomFactor(1.0)
-    , geometries(0)
 {
+    this->refineTimer.setSingleShot(true);
+    this->refineTimer.setInterval(REFINE_DELAY_MS);
+    connect(&this->refineTimer, SIGNAL(timeout()), this, SLOT(endInteraction()));
 }
 
 GLWidget::~GLWidget()
 {
-    // Make sure the context is current when deleting the buffers.
+    // Make sure the context is current when deleting the vertex array. The
+    // buffers themselves belong to the mesh or scene and may outlive this
+    // view.
     this->makeCurrent();
-    delete this->geometries;
+    this->releaseResource();
     this->doneCurrent();
 }
 
-void GLWidget::makeObjectFromSTLFile(StlFile &_stlfile)
+GpuResource *GLWidget::getResource() const
+{
+    if (this->scene)
+        return this->scene.data();
+    return this->mesh.data();
+}
+
+void GLWidget::releaseResource()
 {
-    this->stlfile = &_stlfile;
-    // geometries is created inside initializeGL(), which Qt calls lazily on
-    // first paint.  If the widget hasn't been shown yet, defer the GPU upload
-    // to initializeGL(); otherwise upload now.
-    if (this->geometries) {
+    if (GpuResource *resource = this->getResource())
+    {
         this->makeCurrent();
-        this->geometries->initGeometry(_stlfile);
+        resource->releaseVertexArray();
     }
-    StlFile::Stats stats = _stlfile.getStats();
-    qDebug() << "max:" << stats.max.x << stats.max.y << stats.max.z;
-    qDebug() << "min:" << stats.min.x << stats.min.y << stats.min.z;
-    QVector3D trans = QVector3D((stats.max.x + stats.min.x) / 2,
-                          (stats.max.y + stats.min.y) / 2,
-                          (stats.max.z + stats.min.z) / 2);
+    this->mesh.reset();
+    this->scene.reset();
+}
+
+void GLWidget::setMesh(const QSharedPointer<MeshResource> &_mesh)
+{
+    if (this->mesh != _mesh)
+        this->releaseResource();
+    this->mesh = _mesh;
+    // The GPU buffers are uploaded on first paint, or reused if another view
+    // already shows this mesh.
+    this->resetView(_mesh->getStats());
+}
+
+void GLWidget::setScene(const QSharedPointer<Scene> &_scene)
+{
+    if (this->scene != _scene)
+        this->releaseResource();
+    this->scene = _scene;
+    this->resetView(_scene->getStats());
+}
+
+void GLWidget::resetView(const StlFile::Stats &_stats)
+{
+    qDebug() << "max:" << _stats.max.x << _stats.max.y << _stats.max.z;
+    qDebug() << "min:" << _stats.min.x << _stats.min.y << _stats.min.z;
+    QVector3D trans = QVector3D((_stats.max.x + _stats.min.x) / 2,
+                          (_stats.max.y + _stats.min.y) / 2,
+                          (_stats.max.z + _stats.min.z) / 2);
     this->pos = QVector3D(0.0, 0.0, 0.0);
     this->defaultZoomFactor = std::max({
-        std::abs(stats.max.x - stats.min.x),
-        std::abs(stats.max.y - stats.min.y),
-        std::abs(stats.max.z - stats.min.z)});
+        std::abs(_stats.max.x - _stats.min.x),
+        std::abs(_stats.max.y - _stats.min.y),
+        std::abs(_stats.max.z - _stats.min.z)});
     this->zoomInc = this->defaultZoomFactor / 500;
     this->setDefaultView();
     this->modelMatrix.setToIdentity();
@@ -197,6 +233,21 @@ void GLWidget::setYAxisMode(bool _isReversed)
     GLWidget::yAxisReversed = _isReversed;
 }
 
+void GLWidget::setDerivedNormalsMode(bool _derived)
+{
+    GLWidget::derivedNormals = _derived;
+}
+
+void GLWidget::refreshGeometry()
+{
+    if (!this->getResource() || !this->isValid())
+        return;
+    this->makeCurrent();
+    this->getResource()->geometry(!GLWidget::derivedNormals);
+    this->doneCurrent();
+    this->update();
+}
+
 QSize GLWidget::minimumSizeHint() const
 {
     return QSize(50, 50);
@@ -214,6 +265,23 @@ void GLWidget::mousePressEvent(QMouseEvent *_event)
 
 void GLWidget::mouseReleaseEvent(QMouseEvent *)
 {
+    if (this->interacting)
+    {
+        this->refineTimer.stop();
+        this->endInteraction();
+    }
+}
+
+void GLWidget::beginInteraction()
+{
+    this->interacting = true;
+    this->refineTimer.start();
+}
+
+void GLWidget::endInteraction()
+{
+    this->interacting = false;
+    this->update();
 }
 
 void GLWidget::mouseMoveEvent(QMouseEvent *_event)
@@ -240,6 +308,7 @@ void GLWidget::mouseMoveEvent(QMouseEvent *_event)
         {
             step = this->zoomFactor / this->height;
         }
+        this->beginInteraction();
         this->setPosition(QVector3D(dx * step, -dy * step, 0.0) + this->pos);
     }
     else if ((_event->buttons() & Qt::LeftButton &&
@@ -249,6 +318,7 @@ void GLWidget::mouseMoveEvent(QMouseEvent *_event)
         QQuaternion rot;
         rot = QQuaternion::fromAxisAndAngle(1.0, 0.0, 0.0, dy);
         rot *= QQuaternion::fromAxisAndAngle(0.0, 0.0, 1.0, dx);
+        this->beginInteraction();
         this->setRotation(rot * this->rot);
     }
     this->lastPos = _event->pos();
@@ -258,6 +328,7 @@ void GLWidget::wheelEvent(QWheelEvent *_event)
 {
     int delta = _event->angleDelta().y();
 
+    this->beginInteraction();
     setZoomFactor(this->zoomFactor - delta * this->zoomInc);
 }
 
@@ -293,10 +364,6 @@ void GLWidget::initializeGL()
     // Enable depth buffer
     glEnable(GL_DEPTH_TEST);
 
-    this->geometries = new GeometryEngine;
-    if (this->stlfile)
-        this->geometries->initGeometry(*this->stlfile);
-
     this->initGizmo();
 }
 
@@ -320,25 +387,29 @@ void GLWidget::paintGL()
     this->program.setUniformValue("modelViewMatrix", modelViewMatrix);
     this->program.setUniformValue("projectionMatrix", this->projection);
 
-    if (!this->wireframeMode)
+    // Edges and back faces are resolved in the fragment shader, so a single
+    // pass covers both the solid and the wireframe mode.
+    this->program.setUniformValue("u_wireframe", this->wireframeMode ? 1 : 0);
+    if (this->wireframeMode)
     {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     }
-    else
+
+    if (GpuResource *resource = this->getResource())
     {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    }
-    glCullFace(GL_BACK);
+        GeometryEngine *geometries = resource->geometry(!GLWidget::derivedNormals);
 
-    this->geometries->drawTriangleGeometry(this->program);
+        // While the view is being manipulated, draw the coarse proxy only.
+        const bool proxy = this->interacting && geometries->hasProxy();
+
+        geometries->drawTriangleGeometry(this->program, proxy);
+    }
 
-    if (!this->wireframeMode)
+    if (this->wireframeMode)
     {
-        glCullFace(GL_FRONT);
-        glPolygonMode(GL_BACK, GL_LINE);
-        this->geometries->drawTriangleGeometry(this->program);
-        glPolygonMode(GL_BACK, GL_FILL);
-        glCullFace(GL_BACK);
+        glDisable(GL_BLEND);
+        this->program.setUniformValue("u_wireframe", 0);
     }
 
     // Draw the world-origin gizmo on top of everything.
@@ -383,6 +454,8 @@ void GLWidget::drawGizmo()
     this->program.setUniformValue("normalMatrix",
         (viewMatrix * gizmoModel).normalMatrix());
     this->program.setUniformValue("u_flatMode", 1);
+    this->program.setUniformValue("u_positionOffset", QVector3D(0.0f, 0.0f, 0.0f));
+    this->program.setUniformValue("u_positionScale", QVector3D(1.0f, 1.0f, 1.0f));
 
     glDisable(GL_DEPTH_TEST);
     glLineWidth(2.0f);
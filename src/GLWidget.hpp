@@ -23,7 +23,8 @@
 
 #include "qt.hpp"
 #include "STLFile.hpp"
-#include "GeometryEngine.hpp"
+#include "MeshResource.hpp"
+#include "Scene.hpp"
 
 namespace stlviewer
 {
@@ -42,7 +43,21 @@ namespace stlviewer
 
         public: ~GLWidget();
 
-        public: void makeObjectFromSTLFile(StlFile &_stlFile);
+        /// \brief Show _mesh and reset the view to fit it.
+        public: void setMesh(const QSharedPointer<MeshResource> &_mesh);
+
+        /// \brief Return the mesh shown in this view, which may be shared
+        /// with other views.
+        public: QSharedPointer<MeshResource> getMesh() const { return this->mesh; };
+
+        /// \brief Show _scene instead of a single mesh and reset the view to
+        /// fit it.
+        public: void setScene(const QSharedPointer<Scene> &_scene);
+
+        public: QSharedPointer<Scene> getScene() const { return this->scene; };
+
+        /// \brief Return the mesh or the scene shown, or nullptr.
+        public: GpuResource *getResource() const;
 
         public: void deleteObject();
 
@@ -74,6 +89,19 @@ namespace stlviewer
         public: static bool isYAxisReversed()
                 { return GLWidget::yAxisReversed; };
 
+        /// \brief Return true if flat normals are derived in the shader
+        /// instead of being uploaded with the mesh.
+        public: static bool isDerivedNormalsModeActivated()
+                { return GLWidget::derivedNormals; };
+
+        /// \brief Select whether meshes uploaded from now on store normals.
+        /// Call refreshGeometry() to apply the mode to a loaded mesh.
+        public: static void setDerivedNormalsMode(bool _derived);
+
+        /// \brief Upload the mesh again if its vertex layout does not match
+        /// the current normals mode.
+        public: void refreshGeometry();
+
         public: void setLeftMouseButtonMode(const GLWidget::LeftMouseButtonMode);
 
         public: QQuaternion getRotation() const { return this->rot; };
@@ -90,6 +118,9 @@ namespace stlviewer
 
         public slots: static void setYAxisMode(bool isReversed);
 
+        /// \brief Leave interaction mode and redraw the full mesh.
+        private slots: void endInteraction();
+
         signals: void rotationChanged(const QQuaternion &_angle) const;
 
         signals: void positionChanged(const QVector3D &_pos) const;
@@ -118,6 +149,16 @@ namespace stlviewer
 
         private: void updateProjection();
 
+        /// \brief Drop the current mesh or scene.
+        private: void releaseResource();
+
+        /// \brief Center the view on the bounding box in _stats.
+        private: void resetView(const StlFile::Stats &_stats);
+
+        /// \brief Draw the coarse proxy until the user stops manipulating
+        /// the view.
+        private: void beginInteraction();
+
         private: void drawAxes();
 
         private: void initGizmo();
@@ -134,6 +175,12 @@ namespace stlviewer
 
         private: bool wireframeMode;
 
+        /// \brief True while the view is being rotated, panned or zoomed.
+        private: bool interacting;
+
+        /// \brief Ends interaction mode once the mouse has been idle.
+        private: QTimer refineTimer;
+
         private: LeftMouseButtonMode leftMouseButtonMode;
 
         private: QQuaternion rot;
@@ -151,11 +198,12 @@ namespace stlviewer
 
         private: static bool yAxisReversed;
 
+        private: static bool derivedNormals;
+
         private: QPoint lastPos;
 
         private: QOpenGLShaderProgram program;
 
-        private: GeometryEngine *geometries;
 
         private: QOpenGLVertexArrayObject gizmoVAO;
 
@@ -169,7 +217,10 @@ namespace stlviewer
 
         private: qreal angularSpeed;
 
-        private: StlFile *stlfile;
+        private: QSharedPointer<MeshResource> mesh;
+
+        /// \brief Scene shown instead of mesh, if any.
+        private: QSharedPointer<Scene> scene;
 
         private: qreal aspect;
 
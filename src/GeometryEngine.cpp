@@ -19,75 +19,431 @@
 // THE SOFTWARE.
 
 #include "GeometryEngine.hpp"
+#include "TaskScheduler.hpp"
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLVersionFunctionsFactory>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#ifndef GL_INT_2_10_10_10_REV
+#define GL_INT_2_10_10_10_REV 0x8D9F
+#endif
+
+#ifndef GL_TEXTURE_BUFFER
+#define GL_TEXTURE_BUFFER 0x8C2A
+#endif
+
+#ifndef GL_RGBA32F
+#define GL_RGBA32F 0x8814
+#endif
 
 using namespace stlviewer;
 
+// Maximum number of facets drawn while the view is being manipulated.
+// Meshes smaller than twice this size are always drawn in full.
+static const int PROXY_FACET_BUDGET = 250000;
+
+// Number of facets read and packed per mapped range during upload.
+static const int UPLOAD_CHUNK_FACETS = 262144;
+
+// Number of facets packed by one task.
+static const int PACK_GRAIN_FACETS = 16384;
+
+// RGBA texels per entry of the part table, see GeometryEngine::partBuf.
+static const int PART_TEXELS = 6;
+
+// Map a coordinate to [0, 65535] within [_min, _min + _size].
+static GLushort quantize(float _value, float _min, float _size)
+{
+    if (_size <= 0.0f)
+        return 0;
+    float t = (_value - _min) / _size;
+    t = std::max(0.0f, std::min(1.0f, t));
+    return static_cast<GLushort>(std::lround(t * 65535.0f));
+}
+
+// Pack a normal into the signed, normalized 2_10_10_10 format.
+static GLuint packNormal(float _x, float _y, float _z)
+{
+    float len = std::sqrt(_x * _x + _y * _y + _z * _z);
+    if (len > 0.0f)
+    {
+        _x /= len;
+        _y /= len;
+        _z /= len;
+    }
+    auto pack = [](float v) -> GLuint {
+        v = std::max(-1.0f, std::min(1.0f, v));
+        return static_cast<GLuint>(static_cast<int>(std::lround(v * 511.0f))) & 0x3FF;
+    };
+    return pack(_x) | (pack(_y) << 10) | (pack(_z) << 20);
+}
+
 GeometryEngine::GeometryEngine()
-    : vertexBuf(QOpenGLBuffer::VertexBuffer)
-    , normalBuf(QOpenGLBuffer::VertexBuffer)
+    : generation(0)
+    , vertexBuf(QOpenGLBuffer::VertexBuffer)
+    , vertexCount(0)
+    , withNormals(true)
+    , scene(false)
+    , partBuf(QOpenGLBuffer::VertexBuffer)
+    , partTexture(0)
+    , partsDirty(false)
+    , proxyIndexBuf(QOpenGLBuffer::IndexBuffer)
+    , proxyCount(0)
+    , resident(false)
 {
     this->initializeOpenGLFunctions();
 
-    this->vao.create();
-    // Generate 2 VBOs
     this->vertexBuf.create();
-    this->normalBuf.create();
+    this->proxyIndexBuf.create();
 }
 
 GeometryEngine::~GeometryEngine()
 {
+    for (const VertexArray &entry : this->vertexArrays)
+        delete entry.vao;
     this->vertexBuf.destroy();
-    this->normalBuf.destroy();
+    this->proxyIndexBuf.destroy();
+    this->partBuf.destroy();
+    // Unlike buffers, textures are not released through the share group.
+    if (this->partTexture && QOpenGLContext::currentContext())
+        glDeleteTextures(1, &this->partTexture);
+}
+
+void GeometryEngine::initGeometry(StlFile &_stlfile, bool _withNormals)
+{
+    this->upload(std::vector<StlFile *>(1, &_stlfile), _withNormals, false);
+}
+
+void GeometryEngine::initGeometry(const std::vector<StlFile *> &_parts,
+                                  bool _withNormals)
+{
+    this->upload(_parts, _withNormals, true);
 }
 
-void GeometryEngine::initGeometry(StlFile &_stlfile)
+void GeometryEngine::upload(const std::vector<StlFile *> &_parts, bool _withNormals,
+                            bool _scene)
 {
-    _stlfile.reset();
-    StlFile::Stats stats = _stlfile.getStats();
-    QVector<QVector3D> vertices;
-    QVector<QVector3D> normals;
-    for (int i = 0; i < stats.numFacets; ++i)
+    // Positions are stored relative to the bounding box of their part; the
+    // vertex shader maps them back with the offset and scale of the part.
+    this->parts.resize(_parts.size());
+    int numFacets = 0;
+    for (size_t p = 0; p < _parts.size(); ++p)
     {
-        StlFile::Facet facet = _stlfile.getNextFacet();
+        StlFile::Stats stats = _parts[p]->getStats();
+        Part &part = this->parts[p];
+        part.offset = QVector3D(stats.min.x, stats.min.y, stats.min.z);
+        part.scale = QVector3D(stats.max.x - stats.min.x,
+                               stats.max.y - stats.min.y,
+                               stats.max.z - stats.min.z);
+        part.first = 3 * numFacets;
+        part.count = 3 * stats.numFacets;
+        numFacets += stats.numFacets;
+    }
+    this->scene = _scene;
+    this->partsDirty = _scene;
+    this->withNormals = _withNormals;
+    this->vertexCount = 3 * numFacets;
+    ++this->generation;
 
-        vertices << QVector3D(facet.vector[0].x, facet.vector[0].y, facet.vector[0].z);
-        vertices << QVector3D(facet.vector[1].x, facet.vector[1].y, facet.vector[1].z);
-        vertices << QVector3D(facet.vector[2].x, facet.vector[2].y, facet.vector[2].z);
+    // Allocate the VBO at its final size, then pack the facets chunk by
+    // chunk straight into mapped ranges of it, in parallel. If the driver
+    // cannot map, the chunks go through a small staging buffer instead.
+    const int facetSize = 3 * this->vertexStride();
+    this->vertexBuf.bind();
+    this->vertexBuf.allocate(numFacets * facetSize);
 
-        QVector3D n(facet.normal.x, facet.normal.y, facet.normal.z);
-        normals << n;
-        normals << n;
-        normals << n;
+    std::vector<StlFile::Facet> facets;
+    std::vector<char> staging;
+    for (size_t p = 0; p < _parts.size(); ++p)
+    {
+        StlFile &stlfile = *_parts[p];
+        const int partFacets = this->parts[p].count / 3;
+        const int partOffset = this->parts[p].first / 3 * facetSize;
+        stlfile.reset();
+        for (int first = 0; first < partFacets; first += UPLOAD_CHUNK_FACETS)
+        {
+            const int count = std::min(UPLOAD_CHUNK_FACETS, partFacets - first);
+            facets.resize(count);
+            try
+            {
+                stlfile.readFacets(first, count, facets.data());
+            }
+            catch (const StlFile::error_opening_file &)
+            {
+                // The file changed or vanished since it was parsed.
+                std::fill(facets.begin(), facets.end(), StlFile::Facet());
+            }
+
+            char *dst = static_cast<char *>(this->vertexBuf.mapRange(
+                partOffset + first * facetSize, count * facetSize,
+                QOpenGLBuffer::RangeWrite | QOpenGLBuffer::RangeInvalidate |
+                QOpenGLBuffer::RangeUnsynchronized));
+            const bool mapped = (dst != nullptr);
+            if (!mapped)
+            {
+                staging.resize(static_cast<size_t>(count) * facetSize);
+                dst = staging.data();
+            }
+
+            const int part = static_cast<int>(p);
+            parallelFor(0, count, PACK_GRAIN_FACETS, [&](size_t _b, size_t _e) {
+                for (size_t i = _b; i < _e; ++i)
+                    this->packFacet(facets[i], part, dst + i * facetSize);
+            });
+
+            if (mapped)
+                this->vertexBuf.unmap();
+            else
+                this->vertexBuf.write(partOffset + first * facetSize, dst,
+                                      count * facetSize);
+        }
+    }
+
+    this->initProxy(numFacets);
+    this->resident = true;
+}
+
+void GeometryEngine::setPartAttributes(int _part, const QMatrix4x4 &_transform,
+                                       const QVector3D &_color, bool _visible)
+{
+    Part &part = this->parts[_part];
+    part.transform = _transform;
+    part.color = _color;
+    part.visible = _visible;
+    this->partsDirty = true;
+}
+
+void GeometryEngine::uploadPartTable()
+{
+    std::vector<GLfloat> table;
+    table.reserve(this->parts.size() * PART_TEXELS * 4);
+    this->drawFirsts.clear();
+    this->drawCounts.clear();
+    for (const Part &part : this->parts)
+    {
+        const GLfloat texels[PART_TEXELS][4] = {
+            { part.offset.x(), part.offset.y(), part.offset.z(), 0.0f },
+            { part.scale.x(), part.scale.y(), part.scale.z(), 0.0f },
+            { part.color.x(), part.color.y(), part.color.z(), 1.0f },
+            { part.transform(0, 0), part.transform(0, 1), part.transform(0, 2), part.transform(0, 3) },
+            { part.transform(1, 0), part.transform(1, 1), part.transform(1, 2), part.transform(1, 3) },
+            { part.transform(2, 0), part.transform(2, 1), part.transform(2, 2), part.transform(2, 3) },
+        };
+        table.insert(table.end(), &texels[0][0], &texels[0][0] + PART_TEXELS * 4);
+
+        if (part.visible && part.count > 0)
+        {
+            this->drawFirsts.push_back(part.first);
+            this->drawCounts.push_back(part.count);
+        }
     }
 
-    // Transfer vertex data to VBO
+    if (!this->partBuf.isCreated())
+        this->partBuf.create();
+    this->partBuf.bind();
+    this->partBuf.allocate(table.data(), static_cast<int>(table.size() * sizeof(GLfloat)));
+    this->partBuf.release();
+
+    QOpenGLFunctions_3_3_Core *gl =
+        QOpenGLVersionFunctionsFactory::get<QOpenGLFunctions_3_3_Core>(
+            QOpenGLContext::currentContext());
+    if (!this->partTexture)
+        glGenTextures(1, &this->partTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, this->partTexture);
+    gl->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, this->partBuf.bufferId());
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    this->partsDirty = false;
+}
+
+qint64 GeometryEngine::residentBytes() const
+{
+    if (!this->resident)
+        return 0;
+    return static_cast<qint64>(this->vertexCount) * this->vertexStride() +
+           static_cast<qint64>(this->proxyCount) * sizeof(GLuint);
+}
+
+void GeometryEngine::releaseBuffers()
+{
+    if (!this->resident)
+        return;
+
+    // Respecify both buffers with no storage. The index buffer is bound to
+    // the array target here, since the element array binding is VAO state.
     this->vertexBuf.bind();
-    this->vertexBuf.allocate(vertices.constData(), vertices.length() * sizeof(QVector3D));
+    this->vertexBuf.allocate(0);
+    glBindBuffer(GL_ARRAY_BUFFER, this->proxyIndexBuf.bufferId());
+    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    this->vertexCount = 0;
+    this->proxyCount = 0;
+    this->resident = false;
+}
 
-    // Transfer normal data to VBO
-    this->normalBuf.bind();
-    this->normalBuf.allocate(normals.constData(), normals.length() * sizeof(QVector3D));
+int GeometryEngine::vertexStride() const
+{
+    return this->withNormals ? sizeof(PackedVertex)
+                             : offsetof(PackedVertex, normal);
 }
 
-void GeometryEngine::drawTriangleGeometry(QOpenGLShaderProgram &_program)
+void GeometryEngine::packFacet(const StlFile::Facet &_facet, int _part,
+                               char *_dst) const
 {
-    QOpenGLVertexArrayObject::Binder vaoBinder(&this->vao);
+    const Part &part = this->parts[_part];
+    const int stride = this->vertexStride();
+    const GLuint n = packNormal(_facet.normal.x, _facet.normal.y, _facet.normal.z);
+    for (int j = 0; j < 3; ++j)
+    {
+        PackedVertex v;
+        v.position[0] = quantize(_facet.vector[j].x, part.offset.x(), part.scale.x());
+        v.position[1] = quantize(_facet.vector[j].y, part.offset.y(), part.scale.y());
+        v.position[2] = quantize(_facet.vector[j].z, part.offset.z(), part.scale.z());
+        v.position[3] = static_cast<GLushort>(_part);
+        v.normal = n;
+        std::memcpy(_dst + j * stride, &v, stride);
+    }
+}
 
-    // 1st attribute buffer : vertices
+QOpenGLVertexArrayObject *GeometryEngine::vertexArray()
+{
+    VertexArray &entry = this->vertexArrays[QOpenGLContext::currentContext()];
+    if (!entry.vao)
+    {
+        entry.vao = new QOpenGLVertexArrayObject;
+        entry.vao->create();
+    }
+    if (entry.generation != this->generation)
+    {
+        QOpenGLVertexArrayObject::Binder vaoBinder(entry.vao);
+        this->initVertexArray();
+        entry.generation = this->generation;
+    }
+    return entry.vao;
+}
+
+void GeometryEngine::releaseVertexArray()
+{
+    delete this->vertexArrays.take(QOpenGLContext::currentContext()).vao;
+}
+
+void GeometryEngine::initVertexArray()
+{
     this->vertexBuf.bind();
-    int vertexAttr = _program.attributeLocation("a_position");
-    _program.enableAttributeArray(vertexAttr);
-    _program.setAttributeBuffer(vertexAttr, GL_FLOAT, 0, 3, sizeof(QVector3D));
 
-    // 2rd attribute buffer : normals
-    this->normalBuf.bind();
-    int normalAttr = _program.attributeLocation("a_normal");
-    _program.enableAttributeArray(normalAttr);
-    _program.setAttributeBuffer(normalAttr, GL_FLOAT, 0, 3, sizeof(QVector3D));
+    const GLsizei stride = this->vertexStride();
+
+    glEnableVertexAttribArray(POSITION_ATTRIBUTE);
+    glVertexAttribPointer(POSITION_ATTRIBUTE, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                          reinterpret_cast<const void *>(offsetof(PackedVertex, position)));
+
+    if (this->withNormals)
+    {
+        glEnableVertexAttribArray(NORMAL_ATTRIBUTE);
+        glVertexAttribPointer(NORMAL_ATTRIBUTE, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride,
+                              reinterpret_cast<const void *>(offsetof(PackedVertex, normal)));
+    }
+    else
+    {
+        glDisableVertexAttribArray(NORMAL_ATTRIBUTE);
+    }
 
-    //int vertexColor = _program.attributeLocation("a_color");
-    //_program.enableAttributeArray(vertexColor);
-    //_program.setAttributeValue(vertexColor, QVector3D(1.0, 0.0, 1.0));
+    if (this->scene)
+    {
+        glEnableVertexAttribArray(PART_ATTRIBUTE);
+        glVertexAttribPointer(PART_ATTRIBUTE, 1, GL_UNSIGNED_SHORT, GL_FALSE, stride,
+                              reinterpret_cast<const void *>(
+                                  offsetof(PackedVertex, position) + 3 * sizeof(GLushort)));
+    }
+    else
+    {
+        glDisableVertexAttribArray(PART_ATTRIBUTE);
+    }
+
+    this->proxyIndexBuf.bind();
+}
+
+void GeometryEngine::initProxy(int _numFacets)
+{
+    this->proxyCount = 0;
+    if (_numFacets < 2 * PROXY_FACET_BUDGET)
+        return;
+
+    // Keep every n-th facet.  The proxy shares the full vertex buffer, so
+    // only the indices have to be stored.
+    const int stride = (_numFacets + PROXY_FACET_BUDGET - 1) / PROXY_FACET_BUDGET;
+    std::vector<GLuint> indices;
+    indices.reserve(3 * (_numFacets / stride + 1));
+    for (int i = 0; i < _numFacets; i += stride)
+    {
+        indices.push_back(3 * i);
+        indices.push_back(3 * i + 1);
+        indices.push_back(3 * i + 2);
+    }
+
+    // The element buffer binding is VAO state, so upload it with one bound.
+    QOpenGLVertexArrayObject::Binder vaoBinder(this->vertexArray());
+    this->proxyIndexBuf.bind();
+    this->proxyIndexBuf.allocate(indices.data(),
+                                 static_cast<int>(indices.size() * sizeof(GLuint)));
+    this->proxyCount = static_cast<int>(indices.size());
+}
+
+void GeometryEngine::drawTriangleGeometry(QOpenGLShaderProgram &_program,
+                                          bool _proxy)
+{
+    if (this->scene && this->partsDirty)
+        this->uploadPartTable();
+
+    QOpenGLVertexArrayObject::Binder vaoBinder(this->vertexArray());
+
+    _program.setUniformValue("u_deriveNormals", this->withNormals ? 0 : 1);
+
+    if (!this->scene)
+    {
+        _program.setUniformValue("u_positionOffset", this->parts[0].offset);
+        _program.setUniformValue("u_positionScale", this->parts[0].scale);
+
+        if (_proxy && this->proxyCount > 0)
+        {
+            glDrawElements(GL_TRIANGLES, this->proxyCount, GL_UNSIGNED_INT, nullptr);
+        }
+        else
+        {
+            glDrawArrays(GL_TRIANGLES, 0, this->vertexCount);
+        }
+        return;
+    }
+
+    // Offsets, scales, colors and transforms come from the part table, so
+    // the whole scene is a single draw call whatever its part count.
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, this->partTexture);
+    _program.setUniformValue("u_parts", 0);
+    _program.setUniformValue("u_scene", 1);
+
+    const bool allVisible = this->drawCounts.size() == this->parts.size();
+    if (_proxy && this->proxyCount > 0 && allVisible)
+    {
+        glDrawElements(GL_TRIANGLES, this->proxyCount, GL_UNSIGNED_INT, nullptr);
+    }
+    else if (!this->drawCounts.empty())
+    {
+        QOpenGLFunctions_3_3_Core *gl =
+            QOpenGLVersionFunctionsFactory::get<QOpenGLFunctions_3_3_Core>(
+                QOpenGLContext::currentContext());
+        gl->glMultiDrawArrays(GL_TRIANGLES, this->drawFirsts.data(),
+                              this->drawCounts.data(),
+                              static_cast<GLsizei>(this->drawCounts.size()));
+    }
 
-    glDrawArrays(GL_TRIANGLES, 0, this->vertexBuf.size() / sizeof(QVector3D));
+    _program.setUniformValue("u_scene", 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
 }
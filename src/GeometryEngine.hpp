@@ -21,6 +21,8 @@
 #ifndef _GEOMETRYENGINE_HPP
 #define _GEOMETRYENGINE_HPP
 
+#include <vector>
+
 #include "qt.hpp"
 #include "STLFile.hpp"
 
@@ -29,21 +31,178 @@ namespace stlviewer
 
 class GeometryEngine : protected QOpenGLFunctions
 {
+    /// \brief Attribute locations, fixed in the vertex shader.
+    public: enum AttributeLocation
+    {
+        POSITION_ATTRIBUTE = 0,
+        NORMAL_ATTRIBUTE = 1,
+        PART_ATTRIBUTE = 2
+    };
+
+    /// \brief Interleaved vertex as stored in the vertex buffer (12 bytes).
+    /// Without normals, only the first 8 bytes are stored per vertex.
+    public: struct PackedVertex
+    {
+        /// \brief Position quantized to 16 bits relative to the bounding
+        /// box of its part. The 4th component is the part index.
+        GLushort position[4];
+
+        /// \brief Normal packed as GL_INT_2_10_10_10_REV.
+        GLuint normal;
+    };
+
     public: GeometryEngine();
 
     public: virtual ~GeometryEngine();
 
-    public: void drawTriangleGeometry(QOpenGLShaderProgram &_program);
+    /// \brief Draw the mesh with the vertex array object of the current
+    /// context.
+    /// \param[in] _proxy Draw the coarse interaction proxy instead of the
+    /// full mesh, if one was built.
+    public: void drawTriangleGeometry(QOpenGLShaderProgram &_program,
+                                      bool _proxy = false);
+
+    /// \brief Upload the facets of _stlfile.
+    /// \param[in] _withNormals Store the facet normals. Otherwise the
+    /// fragment shader derives flat normals from screen-space derivatives
+    /// and the vertex buffer is a third smaller.
+    public: void initGeometry(StlFile &_stlfile, bool _withNormals = true);
+
+    /// \brief Upload the facets of all _parts into one buffer, to be drawn
+    /// with a single multi-draw call. Each part keeps its own quantization
+    /// and gets a transform, a color and a visibility flag, see
+    /// setPartAttributes(). Attributes of existing parts are kept. At most
+    /// 65536 parts are supported.
+    public: void initGeometry(const std::vector<StlFile *> &_parts,
+                              bool _withNormals = true);
+
+    /// \brief Return the number of parts in the buffer.
+    public: int getPartCount() const { return static_cast<int>(this->parts.size()); }
+
+    /// \brief Set how part _part of a multi-part upload is drawn.
+    public: void setPartAttributes(int _part, const QMatrix4x4 &_transform,
+                                   const QVector3D &_color, bool _visible);
+
+    /// \brief Return true if the vertex buffer holds normals.
+    public: bool hasNormals() const { return this->withNormals; }
+
+    /// \brief Return true if a coarse proxy is available for this mesh.
+    public: bool hasProxy() const { return this->proxyCount > 0; }
+
+    /// \brief Free the vertex array object of the current context.
+    public: void releaseVertexArray();
+
+    /// \brief Return false once releaseBuffers() was called, until the next
+    /// initGeometry().
+    public: bool isResident() const { return this->resident; }
+
+    /// \brief Return the video memory held by the buffers, in bytes.
+    public: qint64 residentBytes() const;
+
+    /// \brief Free the storage of the buffers but keep the objects, so that
+    /// the vertex array objects stay valid. initGeometry() must be called
+    /// before the mesh is drawn again.
+    public: void releaseBuffers();
+
+    /// \brief Upload _parts; _scene selects the per-part attributes.
+    private: void upload(const std::vector<StlFile *> &_parts, bool _withNormals,
+                         bool _scene);
+
+    /// \brief Write the part table to partBuf, bound as a texture buffer.
+    private: void uploadPartTable();
+
+    /// \brief Build the index list of the subsampled proxy mesh.
+    private: void initProxy(int _numFacets);
+
+    /// \brief Return the vertex array object of the current context,
+    /// recording the vertex layout in it if the buffers changed since.
+    private: QOpenGLVertexArrayObject *vertexArray();
+
+    /// \brief Record the vertex layout in the bound VAO.
+    private: void initVertexArray();
+
+    /// \brief Write the three packed vertices of _facet of part _part to
+    /// _dst.
+    private: void packFacet(const StlFile::Facet &_facet, int _part,
+                            char *_dst) const;
 
-    public: void initGeometry(StlFile &_stlfile);
+    /// \brief Size of one vertex in vertexBuf, in bytes.
+    private: int vertexStride() const;
 
-    private: QOpenGLVertexArrayObject vao;
+    /// \brief A vertex array object and the buffer generation it was
+    /// recorded for.
+    private: struct VertexArray
+    {
+        QOpenGLVertexArrayObject *vao = nullptr;
+        int generation = -1;
+    };
 
+    /// \brief Vertex array objects are not shared between contexts, so each
+    /// view drawing this mesh gets its own.
+    private: QHash<QOpenGLContext *, VertexArray> vertexArrays;
+
+    /// \brief Incremented whenever the buffers are re-specified.
+    private: int generation;
+
+    /// \brief Interleaved PackedVertex data.
     private: QOpenGLBuffer vertexBuf;
 
-    private: QOpenGLBuffer normalBuf;
+    /// \brief Number of vertices in vertexBuf.
+    private: int vertexCount;
+
+    /// \brief True if vertexBuf holds full PackedVertex records.
+    private: bool withNormals;
+
+    /// \brief A range of vertexBuf holding one input file.
+    private: struct Part
+    {
+        /// \brief Model-space position of a quantized position of 0.
+        QVector3D offset;
+
+        /// \brief Model-space extent covered by the quantized range.
+        QVector3D scale;
+
+        GLint first = 0;
+
+        GLsizei count = 0;
+
+        QMatrix4x4 transform;
+
+        QVector3D color = QVector3D(0.6f, 0.65f, 0.7f);
+
+        bool visible = true;
+    };
+
+    private: std::vector<Part> parts;
+
+    /// \brief True if the parts are drawn with their own attributes.
+    private: bool scene;
+
+    /// \brief PART_TEXELS RGBA32F texels per part: offset, scale, color and
+    /// the three rows of the affine transform. Read by the vertex shader
+    /// through partTexture.
+    private: QOpenGLBuffer partBuf;
+
+    private: GLuint partTexture;
+
+    /// \brief True if the part table must be written again before drawing.
+    private: bool partsDirty;
+
+    /// \brief First vertex and vertex count of each visible part, passed
+    /// to glMultiDrawArrays().
+    private: std::vector<GLint> drawFirsts;
+
+    private: std::vector<GLsizei> drawCounts;
+
+    /// \brief Indices into vertexBuf of every n-th facet, drawn while the
+    /// user is rotating or panning.
+    private: QOpenGLBuffer proxyIndexBuf;
+
+    /// \brief Number of indices in proxyIndexBuf.
+    private: int proxyCount;
 
-    private: int size;
+    /// \brief True while the buffers hold the uploaded mesh.
+    private: bool resident;
 };
 
 }
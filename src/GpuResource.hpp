@@ -0,0 +1,63 @@
+// Copyright (C) 2009-2015 Olivier Crave
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef _GPURESOURCE_HPP
+#define _GPURESOURCE_HPP
+
+#include "qt.hpp"
+#include "STLFile.hpp"
+#include "GeometryEngine.hpp"
+
+namespace stlviewer
+{
+
+/// \brief Something a GLWidget can draw: a single mesh or a scene.
+///
+/// The GPU buffers are uploaded on demand by geometry() and may be released
+/// at any time by the ResidencyManager.
+class GpuResource
+{
+    public: virtual ~GpuResource() {}
+
+    /// \brief Return the stats shown in the information panels.
+    public: virtual StlFile::Stats getStats() const = 0;
+
+    /// \brief Return the GPU geometry, uploading it first if needed, and
+    /// mark the resource as recently drawn for the ResidencyManager.
+    /// A context of the shared group must be current.
+    /// \param[in] _withNormals Vertex layout to use, see
+    /// GeometryEngine::initGeometry(). The data is uploaded again if the
+    /// current buffers use the other layout.
+    public: virtual GeometryEngine *geometry(bool _withNormals) = 0;
+
+    /// \brief Free the vertex array object of the current context.
+    public: virtual void releaseVertexArray() = 0;
+
+    /// \brief Return the video memory held by the resource, in bytes.
+    public: virtual qint64 residentBytes() const = 0;
+
+    /// \brief Free the GPU buffers. They are uploaded again by the next call
+    /// to geometry(). A context of the shared group must be current.
+    public: virtual void releaseBuffers() = 0;
+};
+
+}
+
+#endif
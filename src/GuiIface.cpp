@@ -66,6 +66,10 @@ bool stlviewer::load()
     fmt.setProfile(QSurfaceFormat::CoreProfile);
     QSurfaceFormat::setDefaultFormat(fmt);
 
+    // Views of the same mesh share its buffers, which requires all widget
+    // contexts to be in one share group.
+    QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
+
     g_app = new QApplication(g_argc, g_argv);
     g_app->setApplicationVersion(STLVIEWER_VERSION);
 
@@ -28,11 +28,16 @@
 #include "AxisGroupBox.hpp"
 #include "DimensionsGroupBox.hpp"
 #include "MeshInformationGroupBox.hpp"
+#include "MeshLoader.hpp"
 #include "PropertiesGroupBox.hpp"
+#include "ResidencyManager.hpp"
 #include "SettingsDialog.hpp"
+#include "TaskScheduler.hpp"
 
 using namespace stlviewer;
 
+static const qint64 BYTES_PER_MB = 1024 * 1024;
+
 // Load an SVG from resources and replace its fill color before rendering.
 // FA4 icons use fill="#000000"; the replacement targets that literal value.
 // Uses Qt's runtime SVG imageformat plugin (no Qt6::Svg compile dependency).
@@ -72,6 +77,11 @@ MainWindow::MainWindow(QWidget *_parent, Qt::WindowFlags _flags)
 
     this->settingsDialog = new SettingsDialog(this);
 
+    this->meshLoader = new MeshLoader(this);
+    connect(this->meshLoader, &MeshLoader::meshLoaded, this, &MainWindow::addMesh);
+    connect(this->meshLoader, &MeshLoader::progress, this, &MainWindow::showLoadProgress);
+    connect(this->meshLoader, &MeshLoader::finished, this, &MainWindow::loadFinished);
+
     // Do these things first.
     {
         this->createActions();
@@ -118,6 +128,14 @@ void MainWindow::createActions()
     g_openAct->setStatusTip(tr("Open an existing file"));
     connect(g_openAct, SIGNAL(triggered()), this, SLOT(open()));
 
+    g_openFolderAsSceneAct = new QAction(tr("Open &Folder as Scene..."), this);
+    g_openFolderAsSceneAct->setStatusTip(tr("Show all STL files of a folder in one view"));
+    connect(g_openFolderAsSceneAct, SIGNAL(triggered()), this, SLOT(openFolderAsScene()));
+
+    g_openFilesAsSceneAct = new QAction(tr("Open Files as S&cene..."), this);
+    g_openFilesAsSceneAct->setStatusTip(tr("Show several STL files in one view"));
+    connect(g_openFilesAsSceneAct, SIGNAL(triggered()), this, SLOT(openFilesAsScene()));
+
     g_saveAct = new QAction(coloredIcon(":/images/fa/save.svg", QColor(0xd0, 0xd0, 0xd0)), tr("&Save"), this);
     g_saveAct->setShortcut(QKeySequence::Save);
     g_saveAct->setStatusTip(tr("Save the document to disk"));
@@ -138,6 +156,10 @@ void MainWindow::createActions()
     g_showSettingsDialogAct->setStatusTip(tr("Show settings"));
     connect(g_showSettingsDialogAct, SIGNAL(triggered()), this, SLOT(showSettingsDialog()));
 
+    g_newViewAct = new QAction(tr("New &View"), this);
+    g_newViewAct->setStatusTip(tr("Open another view of the active file"));
+    connect(g_newViewAct, SIGNAL(triggered()), this, SLOT(newView()));
+
     g_closeAct = new QAction(tr("Cl&ose"), this);
     //g_closeAct->setShortcut(tr("Ctrl+W"));
     g_closeAct->setStatusTip(tr("Close the active window"));
@@ -333,6 +355,8 @@ void MainWindow::createMenuBar()
     QMenu *fileMenu = bar->addMenu(tr("&File"));
     fileMenu->addAction(g_newAct);
     fileMenu->addAction(g_openAct);
+    fileMenu->addAction(g_openFolderAsSceneAct);
+    fileMenu->addAction(g_openFilesAsSceneAct);
     fileMenu->addAction(g_saveAct);
     fileMenu->addAction(g_saveAsAct);
     fileMenu->addAction(g_saveImageAct);
@@ -436,9 +460,9 @@ void MainWindow::dropEvent(QDropEvent* event)
         QStringList pathList;
         QList<QUrl> urlList = mimeData->urls();
 
-        for (int i = 0; i < urlList.size() && i < 32; ++i)
+        for (const QUrl &url : urlList)
         {
-            pathList.append(urlList.at(i).toLocalFile());
+            pathList.append(url.toLocalFile());
         }
 
         if (this->openFiles(pathList))
@@ -446,9 +470,9 @@ void MainWindow::dropEvent(QDropEvent* event)
     }
 }
 
-void MainWindow::openFile(const QString& path)
+void MainWindow::addMesh(const QSharedPointer<MeshResource> &mesh)
 {
-    QMdiSubWindow *existing = this->findRenderWidget(path);
+    QMdiSubWindow *existing = this->findRenderWidget(mesh->fileName());
     if (existing)
     {
         this->mdiArea->setActiveSubWindow(existing);
@@ -456,17 +480,27 @@ void MainWindow::openFile(const QString& path)
     else
     {
         GLMdiChild *child = this->createRenderWidget();
-        if (child->loadFile(path))
-        {
-            statusBar()->showMessage(tr("File loaded"), 2000);
-            child->show();
-        }
-        else
-        {
-            setActiveSubWindow(child);
-            this->mdiArea->closeActiveSubWindow();
-            //child->close();
-        }
+        child->loadMesh(mesh);
+        child->show();
+    }
+}
+
+void MainWindow::showLoadProgress(int done, int total)
+{
+    statusBar()->showMessage(tr("Loading files... %1/%2").arg(done).arg(total));
+}
+
+void MainWindow::loadFinished(int loaded, const QStringList &messages)
+{
+    statusBar()->showMessage(loaded == 1 ? tr("File loaded")
+                                         : tr("%1 files loaded").arg(loaded), 2000);
+    if (!messages.isEmpty())
+    {
+        QMessageBox msgBox(this);
+        msgBox.setIcon(QMessageBox::Warning);
+        msgBox.setText(tr("Some files could not be loaded or have problems."));
+        msgBox.setDetailedText(messages.join("\n"));
+        msgBox.exec();
     }
 }
 
@@ -482,10 +516,8 @@ void MainWindow::initialize()
 
 bool MainWindow::openFiles(const QStringList& pathList)
 {
-    for(int i = 0; i < pathList.size() && i < 32; ++i)
-    {
-        this->openFile(pathList.at(i));
-    }
+    // Files are parsed in the background; windows are added by addMesh().
+    this->meshLoader->load(pathList);
     return !pathList.isEmpty();
 }
 
@@ -516,6 +548,22 @@ void MainWindow::newFile()
     this->propertiesGroupBox->reset();
 }
 
+void MainWindow::newView()
+{
+    GLMdiChild *active = this->activeRenderWidget();
+    if (!active || active->isUntitled)
+        return;
+
+    // The new view shares the parsed file and the GPU buffers of the
+    // active one.
+    GLMdiChild *child = this->createRenderWidget();
+    if (active->getScene())
+        child->loadScene(active->getScene(), active->currentFile());
+    else
+        child->loadMesh(active->getMesh());
+    child->show();
+}
+
 void MainWindow::open()
 {
     QStringList fileNames = QFileDialog::getOpenFileNames(this, tr("Open file(s)"),
@@ -527,6 +575,73 @@ void MainWindow::open()
     }
 }
 
+void MainWindow::openFolderAsScene()
+{
+    QString dirName = QFileDialog::getExistingDirectory(this, tr("Open folder as scene"),
+                                                        this->curDir);
+    if (dirName.isEmpty())
+        return;
+    this->curDir = dirName;
+
+    QMdiSubWindow *existing = this->findRenderWidget(dirName);
+    if (existing)
+    {
+        this->mdiArea->setActiveSubWindow(existing);
+        return;
+    }
+
+    QDir dir(dirName);
+    QStringList pathList;
+    for (const QString &fileName : dir.entryList(QStringList() << "*.stl",
+                                                 QDir::Files | QDir::Readable,
+                                                 QDir::Name | QDir::IgnoreCase))
+    {
+        pathList.append(dir.filePath(fileName));
+    }
+    if (pathList.isEmpty())
+    {
+        statusBar()->showMessage(tr("No STL file in %1").arg(dirName), 2000);
+        return;
+    }
+    this->openScene(pathList, dir.canonicalPath());
+}
+
+void MainWindow::openFilesAsScene()
+{
+    static int sequenceNumber = 1;
+    QStringList fileNames = QFileDialog::getOpenFileNames(this, tr("Open files as scene"),
+        this->curDir, tr("STL Files (*.stl);;All Files (*.*)"));
+    if (!fileNames.isEmpty())
+    {
+        this->curDir = QFileInfo(fileNames.first()).filePath();
+        this->openScene(fileNames, tr("scene%1").arg(sequenceNumber++));
+    }
+}
+
+void MainWindow::openScene(const QStringList& pathList, const QString& name)
+{
+    // The parts are collected in order and the window is created once
+    // they are all parsed, so that the scene is packed only once.
+    MeshLoader *loader = new MeshLoader(this);
+    QSharedPointer<QVector<QSharedPointer<MeshResource>>> parts(
+        new QVector<QSharedPointer<MeshResource>>);
+    connect(loader, &MeshLoader::meshLoaded, this,
+            [parts](const QSharedPointer<MeshResource> &mesh) { parts->append(mesh); });
+    connect(loader, &MeshLoader::progress, this, &MainWindow::showLoadProgress);
+    connect(loader, &MeshLoader::finished, this,
+            [this, loader, parts, name](int loaded, const QStringList &messages) {
+        if (!parts->isEmpty())
+        {
+            GLMdiChild *child = this->createRenderWidget();
+            child->loadScene(QSharedPointer<Scene>::create(*parts), name);
+            child->show();
+        }
+        this->loadFinished(loaded, messages);
+        loader->deleteLater();
+    });
+    loader->load(pathList);
+}
+
 void MainWindow::save()
 {
     if (this->activeRenderWidget() && this->activeRenderWidget()->save())
@@ -553,10 +668,27 @@ void MainWindow::saveImage()
 
 void MainWindow::showSettingsDialog()
 {
-    this->settingsDialog->exec(GLWidget::isYAxisReversed());
+    ResidencyManager *residency = ResidencyManager::instance();
+    this->settingsDialog->exec(GLWidget::isYAxisReversed(),
+                               GLWidget::isDerivedNormalsModeActivated(),
+                               residency->getBudget() / BYTES_PER_MB,
+                               this->workerThreads);
     if (this->settingsDialog->result() == QDialog::Accepted)
     {
         GLWidget::setYAxisMode(this->settingsDialog->isYAxisReversed());
+        GLWidget::setDerivedNormalsMode(
+            this->settingsDialog->isDerivedNormalsModeActivated());
+        residency->setBudget(
+            this->settingsDialog->getVideoMemoryBudget() * BYTES_PER_MB);
+        if (this->settingsDialog->getWorkerThreads() != this->workerThreads)
+        {
+            this->workerThreads = this->settingsDialog->getWorkerThreads();
+            TaskScheduler::instance()->setWorkerCount(this->workerThreads);
+        }
+        for (QMdiSubWindow *window : this->mdiArea->subWindowList())
+        {
+            qobject_cast<GLMdiChild *>(window->widget())->refreshGeometry();
+        }
     }
 }
 
@@ -606,7 +738,8 @@ void MainWindow::about()
 void MainWindow::updateMenus()
 {
     bool hasRenderWidget = (this->activeRenderWidget() != 0);
-    if (hasRenderWidget && !this->activeRenderWidget()->isUntitled)
+    if (hasRenderWidget && !this->activeRenderWidget()->isUntitled &&
+        !this->activeRenderWidget()->getScene())
     {
         g_saveAct->setEnabled(true);
         g_saveAsAct->setEnabled(true);
@@ -617,6 +750,7 @@ void MainWindow::updateMenus()
         g_saveAsAct->setEnabled(false);
     }
     g_saveImageAct->setEnabled(hasRenderWidget);
+    g_newViewAct->setEnabled(hasRenderWidget && !this->activeRenderWidget()->isUntitled);
     g_closeAct->setEnabled(hasRenderWidget);
     g_closeAllAct->setEnabled(hasRenderWidget);
     g_zoomInAct->setEnabled(hasRenderWidget);
@@ -664,6 +798,8 @@ void MainWindow::updateMenus()
 void MainWindow::updateWindowMenu()
 {
     this->windowMenu->clear();
+    this->windowMenu->addAction(g_newViewAct);
+    this->windowMenu->addSeparator();
     this->windowMenu->addAction(g_closeAct);
     this->windowMenu->addAction(g_closeAllAct);
     this->windowMenu->addSeparator();
@@ -946,6 +1082,11 @@ void MainWindow::readSettings()
     QPoint pos = settings.value("pos", QPoint(200, 200)).toPoint();
     QSize size = settings.value("size", QSize(400, 400)).toSize();
     GLWidget::setYAxisMode(settings.value("yAxisReversed", false).toBool());
+    GLWidget::setDerivedNormalsMode(settings.value("derivedNormals", true).toBool());
+    ResidencyManager::instance()->setBudget(
+        settings.value("videoMemoryBudget", 1024).toLongLong() * BYTES_PER_MB);
+    this->workerThreads = settings.value("workerThreads", 0).toInt();
+    TaskScheduler::instance()->setWorkerCount(this->workerThreads);
     this->darkTheme = settings.value("darkTheme", false).toBool();
     resize(size);
     move(pos);
@@ -958,6 +1099,10 @@ void MainWindow::writeSettings()
     settings.setValue("pos", pos());
     settings.setValue("size", size());
     settings.setValue("yAxisReversed", GLWidget::isYAxisReversed());
+    settings.setValue("derivedNormals", GLWidget::isDerivedNormalsModeActivated());
+    settings.setValue("videoMemoryBudget",
+                      ResidencyManager::instance()->getBudget() / BYTES_PER_MB);
+    settings.setValue("workerThreads", this->workerThreads);
     settings.setValue("darkTheme", this->darkTheme);
 }
 
@@ -34,6 +34,8 @@ class SettingsDialog;
 namespace stlviewer
 {
 
+    class MeshLoader;
+
     class MainWindow : public QMainWindow
     {
         Q_OBJECT
@@ -68,7 +70,10 @@ namespace stlviewer
 
         private slots: void initialize();
         private slots: void newFile();
+        private slots: void newView();
         private slots: void open();
+        private slots: void openFolderAsScene();
+        private slots: void openFilesAsScene();
         private slots: void save();
         private slots: void saveAs();
         private slots: void saveImage();
@@ -83,6 +88,9 @@ namespace stlviewer
         private slots: GLMdiChild *createRenderWidget();
         private slots: void setActiveSubWindow(QWidget *window);
         private slots: void destroyRenderWidget();
+        private slots: void addMesh(const QSharedPointer<stlviewer::MeshResource> &mesh);
+        private slots: void showLoadProgress(int done, int total);
+        private slots: void loadFinished(int loaded, const QStringList &messages);
         private slots: void zoomIn();
         private slots: void zoomOut();
         private slots: void zoomDefault();
@@ -100,10 +108,12 @@ namespace stlviewer
         private: void createActions();
         private: void applyTheme(bool dark);
 
-        private: void openFile(const QString& path);
-
         private: bool openFiles(const QStringList& pathList);
 
+        /// \brief Load pathList in the background and show all the files
+        /// in a single scene window called name.
+        private: void openScene(const QStringList& pathList, const QString& name);
+
         private: void createMenus();
 
         private: void createMenuBar();
@@ -126,6 +136,8 @@ namespace stlviewer
 
         private: SettingsDialog *settingsDialog;
 
+        private: MeshLoader *meshLoader;
+
         //private: QMenu *fileMenu;
 
         private: QMenu *windowMenu;
@@ -150,6 +162,9 @@ namespace stlviewer
 
         private: bool darkTheme;
 
+        /// \brief Worker count of the TaskScheduler; 0 means automatic.
+        private: int workerThreads;
+
         private: QWidget *modelInfoDockContent;
         private: QWidget *viewInfoDockContent;
 
@@ -169,10 +184,13 @@ namespace stlviewer
 
         private: QAction *g_newAct;
         private: QAction *g_openAct;
+        private: QAction *g_openFolderAsSceneAct;
+        private: QAction *g_openFilesAsSceneAct;
         private: QAction *g_saveAct;
         private: QAction *g_saveAsAct;
         private: QAction *g_saveImageAct;
         private: QAction *g_showSettingsDialogAct;
+        private: QAction *g_newViewAct;
         private: QAction *g_closeAct;
         private: QAction *g_closeAllAct;
         private: QAction *g_tileAct;
@@ -0,0 +1,140 @@
+// Copyright (C) 2009-2015 Olivier Crave
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "MeshLoader.hpp"
+#include "MeshManager.hpp"
+
+using namespace stlviewer;
+
+MeshLoader::MeshLoader(QObject *_parent)
+    : QObject(_parent)
+    , tasks(cancellation)
+    , firstId(0)
+    , total(0)
+    , done(0)
+    , loaded(0)
+{
+}
+
+MeshLoader::~MeshLoader()
+{
+    this->cancellation.cancel();
+    this->tasks.wait();
+}
+
+void MeshLoader::load(const QStringList &_fileNames)
+{
+    for (const QString &fileName : _fileNames)
+    {
+        const qint64 id = this->firstId + static_cast<qint64>(this->jobs.size());
+        this->jobs.emplace_back();
+        this->jobs.back().fileName = fileName;
+        ++this->total;
+
+        QSharedPointer<MeshResource> mesh = MeshManager::instance()->find(fileName);
+        if (mesh)
+        {
+            this->jobs.back().mesh = mesh;
+            this->jobs.back().done = true;
+            ++this->done;
+            continue;
+        }
+
+        this->tasks.run([this, id, fileName]() {
+            Job job = MeshLoader::parse(fileName);
+            QMetaObject::invokeMethod(this, [this, id, job]() {
+                this->complete(id, job);
+            }, Qt::QueuedConnection);
+        });
+    }
+    this->flush();
+}
+
+MeshLoader::Job MeshLoader::parse(const QString &_fileName)
+{
+    Job job;
+    job.fileName = _fileName;
+    job.done = true;
+    try
+    {
+        job.mesh = QSharedPointer<MeshResource>::create(_fileName);
+        job.warning = QString::fromStdString(job.mesh->stlFile().getWarning());
+    }
+    catch (const StlFile::wrong_header_size&)
+    {
+        job.error = tr("The file has a wrong size.");
+    }
+    catch (const StlFile::error_opening_file&)
+    {
+        job.error = tr("The file could not be opened.");
+    }
+    catch (const ::std::bad_alloc&)
+    {
+        job.error = tr("Problem allocating memory.");
+    }
+    catch (...)
+    {
+        job.error = tr("Error unknown.");
+    }
+    return job;
+}
+
+void MeshLoader::complete(qint64 _id, const Job &_job)
+{
+    this->jobs[static_cast<size_t>(_id - this->firstId)] = _job;
+    ++this->done;
+    emit progress(this->done, this->total);
+    this->flush();
+}
+
+void MeshLoader::flush()
+{
+    while (!this->jobs.empty() && this->jobs.front().done)
+    {
+        Job job = this->jobs.front();
+        this->jobs.pop_front();
+        ++this->firstId;
+
+        const QString name = QFileInfo(job.fileName).fileName();
+        if (!job.warning.isEmpty())
+            this->messages.append(name + ": " + job.warning);
+        if (job.mesh)
+        {
+            // Another view may have opened the same file meanwhile.
+            ++this->loaded;
+            emit meshLoaded(MeshManager::instance()->adopt(job.mesh));
+        }
+        else
+        {
+            this->messages.append(name + ": " + job.error);
+        }
+    }
+
+    if (this->jobs.empty() && this->total > 0)
+    {
+        const int loadedCount = this->loaded;
+        const QStringList messageList = this->messages;
+        this->total = 0;
+        this->done = 0;
+        this->loaded = 0;
+        this->messages.clear();
+        emit finished(loadedCount, messageList);
+    }
+}
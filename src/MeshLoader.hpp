@@ -0,0 +1,106 @@
+// Copyright (C) 2009-2015 Olivier Crave
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef _MESHLOADER_HPP
+#define _MESHLOADER_HPP
+
+#include <deque>
+
+#include "qt.hpp"
+#include "MeshResource.hpp"
+#include "TaskScheduler.hpp"
+
+namespace stlviewer
+{
+
+/// \brief Opens any number of files concurrently.
+///
+/// Files are parsed on the TaskScheduler. meshLoaded() is still
+/// emitted in the order the files were queued: a file that finishes early
+/// waits for the ones queued before it. A file that fails to load is
+/// reported in finished() and does not stop the others.
+class MeshLoader : public QObject
+{
+    Q_OBJECT
+
+    public: explicit MeshLoader(QObject *_parent = nullptr);
+
+    /// \brief Wait for the files being parsed and drop the queued ones.
+    public: ~MeshLoader();
+
+    /// \brief Queue _fileNames. Files already loaded in a view are not
+    /// parsed again.
+    public: void load(const QStringList &_fileNames);
+
+    /// \brief Emitted for each file that was loaded, in queue order.
+    signals: void meshLoaded(const QSharedPointer<stlviewer::MeshResource> &_mesh);
+
+    /// \brief Emitted each time a file is done, loaded or not.
+    signals: void progress(int _done, int _total);
+
+    /// \brief Emitted when the queue is empty.
+    /// \param[in] _loaded Number of files loaded since the queue was last
+    /// empty.
+    /// \param[in] _messages Errors and warnings, one per line, prefixed
+    /// with the file name.
+    signals: void finished(int _loaded, const QStringList &_messages);
+
+    private: struct Job
+    {
+        QString fileName;
+        QSharedPointer<MeshResource> mesh;
+        QString error;
+        QString warning;
+        bool done = false;
+    };
+
+    /// \brief Parse _fileName. Runs on a worker thread.
+    private: static Job parse(const QString &_fileName);
+
+    /// \brief Store the result of job _id and emit what is ready.
+    private: void complete(qint64 _id, const Job &_job);
+
+    /// \brief Emit meshLoaded() for the finished jobs at the head of the
+    /// queue.
+    private: void flush();
+
+    /// \brief Cancelled on destruction to skip the files not started yet.
+    private: CancellationToken cancellation;
+
+    private: TaskGroup tasks;
+
+    /// \brief Queued jobs, oldest first.
+    private: ::std::deque<Job> jobs;
+
+    /// \brief Id of jobs.front(); ids increase in queue order.
+    private: qint64 firstId;
+
+    private: int total;
+
+    private: int done;
+
+    private: int loaded;
+
+    private: QStringList messages;
+};
+
+}
+
+#endif
@@ -0,0 +1,74 @@
+// Copyright (C) 2009-2015 Olivier Crave
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "MeshManager.hpp"
+
+using namespace stlviewer;
+
+MeshManager::MeshManager()
+{
+}
+
+MeshManager *MeshManager::instance()
+{
+    static MeshManager manager;
+    return &manager;
+}
+
+QSharedPointer<MeshResource> MeshManager::acquire(const QString &_fileName)
+{
+    QSharedPointer<MeshResource> mesh = this->find(_fileName);
+    if (!mesh)
+    {
+        this->prune();
+        mesh = QSharedPointer<MeshResource>::create(_fileName);
+        this->meshes.insert(mesh->fileName(), mesh);
+    }
+    return mesh;
+}
+
+QSharedPointer<MeshResource> MeshManager::adopt(const QSharedPointer<MeshResource> &_mesh)
+{
+    QSharedPointer<MeshResource> mesh = this->meshes.value(_mesh->fileName()).toStrongRef();
+    if (!mesh)
+    {
+        this->prune();
+        mesh = _mesh;
+        this->meshes.insert(mesh->fileName(), mesh);
+    }
+    return mesh;
+}
+
+QSharedPointer<MeshResource> MeshManager::find(const QString &_fileName) const
+{
+    const QString canonicalFilePath = QFileInfo(_fileName).canonicalFilePath();
+    return this->meshes.value(canonicalFilePath).toStrongRef();
+}
+
+void MeshManager::prune()
+{
+    for (auto it = this->meshes.begin(); it != this->meshes.end();)
+    {
+        if (it.value().isNull())
+            it = this->meshes.erase(it);
+        else
+            ++it;
+    }
+}
@@ -0,0 +1,65 @@
+// Copyright (C) 2009-2015 Olivier Crave
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef _MESHMANAGER_HPP
+#define _MESHMANAGER_HPP
+
+#include "qt.hpp"
+#include "MeshResource.hpp"
+
+namespace stlviewer
+{
+
+/// \brief Registry of the meshes currently shown in any view.
+///
+/// Views hold strong references to their MeshResource; the manager only
+/// keeps weak ones, so a mesh is freed together with its last view.
+class MeshManager
+{
+    public: static MeshManager *instance();
+
+    /// \brief Return the mesh of _fileName, opening it if no view shows it
+    /// yet.
+    /// \throw StlFile::error_opening_file, StlFile::wrong_header_size
+    public: QSharedPointer<MeshResource> acquire(const QString &_fileName);
+
+    /// \brief Register _mesh, which was opened outside of the manager, e.g.
+    /// on a worker thread. If the same file was loaded meanwhile, the mesh
+    /// already registered is returned instead.
+    public: QSharedPointer<MeshResource> adopt(const QSharedPointer<MeshResource> &_mesh);
+
+    /// \brief Return the mesh of _fileName if it is loaded, or a null
+    /// pointer.
+    public: QSharedPointer<MeshResource> find(const QString &_fileName) const;
+
+    private: MeshManager();
+
+    private: Q_DISABLE_COPY(MeshManager)
+
+    /// \brief Forget the meshes whose last view has been closed.
+    private: void prune();
+
+    /// \brief Loaded meshes, keyed by canonical path.
+    private: QHash<QString, QWeakPointer<MeshResource>> meshes;
+};
+
+}
+
+#endif
@@ -0,0 +1,74 @@
+// Copyright (C) 2009-2015 Olivier Crave
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "MeshResource.hpp"
+#include "ResidencyManager.hpp"
+
+using namespace stlviewer;
+
+MeshResource::MeshResource(const QString &_fileName)
+    : path(QFileInfo(_fileName).canonicalFilePath())
+    , geometries(nullptr)
+{
+    this->file.open(_fileName.toUtf8().constData());
+}
+
+MeshResource::~MeshResource()
+{
+    ResidencyManager::instance()->remove(this);
+
+    // Buffer objects are released through the context group, so they do not
+    // need a current context here.
+    delete this->geometries;
+    this->file.close();
+}
+
+GeometryEngine *MeshResource::geometry(bool _withNormals)
+{
+    if (!this->geometries)
+    {
+        this->geometries = new GeometryEngine;
+        this->geometries->initGeometry(this->file, _withNormals);
+    }
+    else if (!this->geometries->isResident() ||
+             this->geometries->hasNormals() != _withNormals)
+    {
+        this->geometries->initGeometry(this->file, _withNormals);
+    }
+    ResidencyManager::instance()->touch(this);
+    return this->geometries;
+}
+
+qint64 MeshResource::residentBytes() const
+{
+    return this->geometries ? this->geometries->residentBytes() : 0;
+}
+
+void MeshResource::releaseBuffers()
+{
+    if (this->geometries)
+        this->geometries->releaseBuffers();
+}
+
+void MeshResource::releaseVertexArray()
+{
+    if (this->geometries)
+        this->geometries->releaseVertexArray();
+}
@@ -0,0 +1,72 @@
+// Copyright (C) 2009-2015 Olivier Crave
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef _MESHRESOURCE_HPP
+#define _MESHRESOURCE_HPP
+
+#include "qt.hpp"
+#include "STLFile.hpp"
+#include "GeometryEngine.hpp"
+#include "GpuResource.hpp"
+
+namespace stlviewer
+{
+
+/// \brief A parsed STL file together with its GPU buffers.
+///
+/// A MeshResource is shared by every view that shows the same file, see
+/// MeshManager. The GPU buffers are created lazily by the first view that
+/// draws the mesh and live in the shared OpenGL context group, so further
+/// views only add a vertex array object of their own.
+class MeshResource : public GpuResource
+{
+    /// \brief Open and parse _fileName.
+    /// \throw StlFile::error_opening_file, StlFile::wrong_header_size
+    public: explicit MeshResource(const QString &_fileName);
+
+    public: ~MeshResource();
+
+    /// \brief Return the canonical path of the file.
+    public: QString fileName() const { return this->path; }
+
+    public: StlFile &stlFile() { return this->file; }
+
+    public: StlFile::Stats getStats() const Q_DECL_OVERRIDE { return this->file.getStats(); }
+
+    public: GeometryEngine *geometry(bool _withNormals) Q_DECL_OVERRIDE;
+
+    public: void releaseVertexArray() Q_DECL_OVERRIDE;
+
+    public: qint64 residentBytes() const Q_DECL_OVERRIDE;
+
+    public: void releaseBuffers() Q_DECL_OVERRIDE;
+
+    private: Q_DISABLE_COPY(MeshResource)
+
+    private: QString path;
+
+    private: StlFile file;
+
+    private: GeometryEngine *geometries;
+};
+
+}
+
+#endif
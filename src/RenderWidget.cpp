@@ -26,12 +26,15 @@
 #include <QMouseEvent>
 
 #include "RenderWidget.hpp"
+#include "MeshManager.hpp"
 
 using stlviewer::GLWidget;
+using stlviewer::MeshManager;
+using stlviewer::MeshResource;
+using stlviewer::Scene;
 
 GLMdiChild::GLMdiChild(QWidget *parent)
     : GLWidget(parent)
-    , stlFile(new StlFile)
     , isUntitled(true)
 {
     setAttribute(Qt::WA_DeleteOnClose);
@@ -39,7 +42,6 @@ GLMdiChild::GLMdiChild(QWidget *parent)
 
 GLMdiChild::~GLMdiChild()
 {
-    delete this->stlFile;
 }
 
 void GLMdiChild::newFile()
@@ -55,10 +57,15 @@ bool GLMdiChild::loadFile(const QString &fileName)
     try
     {
         QApplication::setOverrideCursor(Qt::WaitCursor);
-        this->stlFile->open(fileName.toUtf8().constData());
-        this->makeObjectFromSTLFile(*this->stlFile);
-        this->setCurrentFile(fileName);
+        this->loadMesh(MeshManager::instance()->acquire(fileName));
         QApplication::restoreOverrideCursor();
+        const ::std::string warning = this->getMesh()->stlFile().getWarning();
+        if (!warning.empty())
+        {
+            QMessageBox msgBox;
+            msgBox.setText(QString::fromStdString(warning));
+            msgBox.exec();
+        }
         return true;
     }
     catch (const StlFile::wrong_header_size&)
@@ -95,8 +102,27 @@ bool GLMdiChild::loadFile(const QString &fileName)
     }
 }
 
+void GLMdiChild::loadMesh(const QSharedPointer<MeshResource> &mesh)
+{
+    this->setMesh(mesh);
+    this->setCurrentFile(mesh->fileName());
+}
+
+void GLMdiChild::loadScene(const QSharedPointer<Scene> &scene, const QString &name)
+{
+    this->setScene(scene);
+    // A scene is not a file: name is its folder, or a generated name.
+    this->curFile = name;
+    isUntitled = false;
+    setWindowModified(false);
+    setWindowTitle(tr("%1 (%2 parts)").arg(userFriendlyCurrentFile())
+                                      .arg(scene->getPartCount()));
+}
+
 bool GLMdiChild::save()
 {
+    if (this->getScene())
+        return false;
     if (isUntitled)
         return saveAs();
     return saveFile(this->curFile);
@@ -104,13 +130,14 @@ bool GLMdiChild::save()
 
 bool GLMdiChild::saveAs()
 {
-    if (!isUntitled)
+    if (!isUntitled && !this->getScene())
     {
         QString filterBin   = tr("STL Files, binary (*.stl)");
         QString filterAscii = tr("STL Files, ASCII (*.stl)");
         QString filterAll   = tr("All files (*.*)");
         QString filterSel;
-        if (this->stlFile->getStats().type == StlFile::ASCII)
+        StlFile &stlFile = this->getMesh()->stlFile();
+        if (stlFile.getStats().type == StlFile::ASCII)
             filterSel = filterAscii;
         else
             filterSel = filterBin;
@@ -120,9 +147,9 @@ bool GLMdiChild::saveAs()
         if (fileName.isEmpty())
             return false;
         if (filterSel == filterBin)
-            this->stlFile->setFormat(StlFile::BINARY);
+            stlFile.setFormat(StlFile::BINARY);
         else if (filterSel == filterAscii)
-            this->stlFile->setFormat(StlFile::ASCII);
+            stlFile.setFormat(StlFile::ASCII);
         return saveFile(fileName);
     }
     return false;
@@ -133,7 +160,7 @@ bool GLMdiChild::saveFile(const QString &fileName)
     try
     {
         QApplication::setOverrideCursor(Qt::WaitCursor);
-        this->stlFile->write(fileName.toUtf8().constData());
+        this->getMesh()->stlFile().write(fileName.toUtf8().constData());
         QApplication::restoreOverrideCursor();
         this->setCurrentFile(fileName);
         return true;
@@ -186,7 +213,7 @@ QString GLMdiChild::userFriendlyCurrentFile()
 
 void GLMdiChild::closeEvent(QCloseEvent *event)
 {
-    this->stlFile->close();
+    // The file is closed with the mesh, once no other view shows it.
     event->accept();
 }
 
@@ -34,13 +34,15 @@ class GLMdiChild : public stlviewer::GLWidget
     ~GLMdiChild();
     void newFile();
     bool loadFile(const QString &fileName);
+    void loadMesh(const QSharedPointer<stlviewer::MeshResource> &mesh);
+    void loadScene(const QSharedPointer<stlviewer::Scene> &scene, const QString &name);
     bool save();
     bool saveAs();
     bool saveFile(const QString &fileName);
     bool saveImage();
     QString userFriendlyCurrentFile();
     QString currentFile() { return curFile; };
-    StlFile::Stats getStats() const { return stlFile->getStats(); };
+    StlFile::Stats getStats() const { return getResource()->getStats(); };
     bool isUntitled;
 
  signals:
@@ -56,7 +58,6 @@ class GLMdiChild : public stlviewer::GLWidget
     bool maybeSave();
     void setCurrentFile(const QString &fileName);
     QString strippedName(const QString &fullFileName);
-    StlFile *stlFile;
     QString curFile;
 };
 
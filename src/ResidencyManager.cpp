@@ -0,0 +1,77 @@
+// Copyright (C) 2009-2015 Olivier Crave
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "ResidencyManager.hpp"
+#include "GpuResource.hpp"
+
+using namespace stlviewer;
+
+ResidencyManager::ResidencyManager()
+    : budget(0)
+{
+}
+
+ResidencyManager *ResidencyManager::instance()
+{
+    static ResidencyManager manager;
+    return &manager;
+}
+
+void ResidencyManager::setBudget(qint64 _bytes)
+{
+    this->budget = _bytes;
+}
+
+void ResidencyManager::touch(GpuResource *_resource)
+{
+    if (this->resources.isEmpty() || this->resources.last() != _resource)
+    {
+        this->resources.removeOne(_resource);
+        this->resources.append(_resource);
+        this->enforceBudget(_resource);
+    }
+}
+
+void ResidencyManager::remove(GpuResource *_resource)
+{
+    this->resources.removeOne(_resource);
+}
+
+qint64 ResidencyManager::residentBytes() const
+{
+    qint64 total = 0;
+    for (const GpuResource *resource : this->resources)
+        total += resource->residentBytes();
+    return total;
+}
+
+void ResidencyManager::enforceBudget(GpuResource *_keep)
+{
+    if (this->budget <= 0)
+        return;
+
+    qint64 total = this->residentBytes();
+    while (total > this->budget && this->resources.first() != _keep)
+    {
+        GpuResource *resource = this->resources.takeFirst();
+        total -= resource->residentBytes();
+        resource->releaseBuffers();
+    }
+}
@@ -0,0 +1,75 @@
+// Copyright (C) 2009-2015 Olivier Crave
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef _RESIDENCYMANAGER_HPP
+#define _RESIDENCYMANAGER_HPP
+
+#include "qt.hpp"
+
+namespace stlviewer
+{
+
+class GpuResource;
+
+/// \brief Keeps the GPU buffers of all meshes and scenes within a video
+/// memory budget.
+///
+/// Resources are kept in least-recently-drawn order. Whenever one is drawn
+/// and the buffers of all resident ones exceed the budget, the buffers of
+/// those drawn longest ago are released. Those are the meshes in hidden,
+/// minimized or covered windows. They are uploaded again from the CPU copy
+/// the next time a view draws them.
+class ResidencyManager
+{
+    public: static ResidencyManager *instance();
+
+    /// \brief Set the budget in bytes; 0 disables eviction.
+    public: void setBudget(qint64 _bytes);
+
+    public: qint64 getBudget() const { return this->budget; }
+
+    /// \brief Mark _resource as the most recently drawn one and evict others
+    /// if the budget is exceeded. A context of the shared group must be
+    /// current.
+    public: void touch(GpuResource *_resource);
+
+    /// \brief Forget _resource, e.g. because it is being destroyed.
+    public: void remove(GpuResource *_resource);
+
+    /// \brief Return the total size of the resident buffers, in bytes.
+    public: qint64 residentBytes() const;
+
+    private: ResidencyManager();
+
+    private: Q_DISABLE_COPY(ResidencyManager)
+
+    /// \brief Release buffers, least recently drawn first, until the
+    /// resident resources fit in the budget. _keep is never evicted.
+    private: void enforceBudget(GpuResource *_keep);
+
+    private: qint64 budget;
+
+    /// \brief Resident resources, least recently drawn first.
+    private: QList<GpuResource *> resources;
+};
+
+}
+
+#endif
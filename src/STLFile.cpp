@@ -18,24 +18,37 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
-#include <QApplication>
-#include <QErrorMessage>
 #include <QDebug>
 #include <cmath>
 #include <cctype>
+#include <cstdio>
 #include <string>
 #include <algorithm>
 #include <vector>
 
 #include "STLFile.hpp"
+#include "TaskScheduler.hpp"
 
 #define HEADER_SIZE 84
 #define JUNK_SIZE 80
 #define SIZE_OF_FACET 50
 #define ASCII_LINES_PER_FACET 7
 
+// Facets handled by one task when reading, reducing or encoding.
+#define BLOCK_FACETS 16384
+// Facets held in memory at once while computing stats or writing.
+#define BATCH_FACETS (16 * BLOCK_FACETS)
+
+using stlviewer::parallelFor;
+using stlviewer::parallelSort;
+
 static bool compareVectors(Vector i, Vector j);
 static bool equalVectors(Vector i, Vector j);
+static float decodeFloat(const char *bytes);
+static void encodeFloat(float valueIn, char *bytes);
+static void decodeFacet(const char *bytes, StlFile::Facet &facet);
+static void encodeFacet(const StlFile::Facet &facet, char *bytes);
+static void formatFacet(const StlFile::Facet &facet, ::std::string &out);
 
 StlFile::StlFile() : stats()
 {
@@ -82,6 +95,8 @@ void StlFile::initialize(const ::std::string& fileName)
     this->stats.numPoints = 0;
     this->stats.surface = -1.0f;
     this->stats.volume = -1.0f;
+    this->warning.clear();
+    this->fileName = fileName;
     fileIn.open(fileName.c_str(), ::std::ios::in | ::std::ios::binary);
     if (fileIn.is_open())
     {
@@ -113,11 +128,7 @@ void StlFile::initialize(const ::std::string& fileName)
             if (numFacets != headerNumFacets)
             {
                 qWarning() << "File size doesn't match number of facets in the header.";
-                QErrorMessage errMessage;
-                errMessage.showMessage("File size doesn't match number of facets in the header.");
-                QApplication::restoreOverrideCursor();
-                errMessage.exec();
-                QApplication::setOverrideCursor(Qt::WaitCursor);
+                this->warning = "File size doesn't match number of facets in the header.";
             }
         }
         else
@@ -202,23 +213,65 @@ StlFile::Facet StlFile::getNextFacet()
     return facet;
 }
 
+void StlFile::readFacets(int _first, int _count, Facet *_facets)
+{
+    if (this->inputType != BINARY)
+    {
+        for (int i = 0; i < _count; i++)
+            _facets[i] = this->getNextFacet();
+        return;
+    }
+
+    const ::std::string &name = this->fileName;
+    parallelFor(0, _count, BLOCK_FACETS, [&](size_t b, size_t e) {
+        ::std::ifstream in(name.c_str(), ::std::ios::in | ::std::ios::binary);
+        in.seekg(HEADER_SIZE + static_cast<::std::streamoff>(_first + b) * SIZE_OF_FACET);
+        ::std::vector<char> buffer((e - b) * SIZE_OF_FACET);
+        in.read(buffer.data(), buffer.size());
+        if (!in)
+        {
+            qWarning() << "The file" << name.c_str() << "could not be read.";
+            throw error_opening_file();
+        }
+        for (size_t i = b; i < e; i++)
+            decodeFacet(buffer.data() + (i - b) * SIZE_OF_FACET, _facets[i]);
+    });
+}
+
+namespace
+{
+    // Stats of one block of facets, merged in block order.
+    struct PartialStats
+    {
+        Vector max;
+        Vector min;
+        double surface = 0.0;
+        // Sum of area * (normal . v0) and of area * normal, from which the
+        // volume relative to the first vertex of the file is derived.
+        double moment = 0.0;
+        double weightedNormal[3] = {0.0, 0.0, 0.0};
+    };
+}
+
 void StlFile::computeStats()
 {
     this->reset();
-    float surface = 0.0f;
-    float volume  = 0.0f;
-    Vector p0;
-    ::std::vector<Vector> vectors;
-
-    for (int i = 0; i < this->stats.numFacets; i++)
+    const int numFacets = this->stats.numFacets;
+    const int numBlocks = (numFacets + BLOCK_FACETS - 1) / BLOCK_FACETS;
+    ::std::vector<PartialStats> partials(numBlocks);
+    ::std::vector<Vector> vectors(3 * static_cast<size_t>(numFacets));
+    ::std::vector<Facet> facets;
+    Vector p0 = Vector();
+
+    for (int first = 0; first < numFacets; first += BATCH_FACETS)
     {
-        Facet facet = getNextFacet();
+        const int count = ::std::min(BATCH_FACETS, numFacets - first);
+        facets.resize(count);
+        this->readFacets(first, count, facets.data());
 
-        if (i == 0)
+        if (first == 0)
         {
-            this->stats.max = facet.vector[0];
-            this->stats.min = facet.vector[0];
-
+            const Facet &facet = facets[0];
             float xDiff = std::abs(facet.vector[0].x - facet.vector[1].x);
             float yDiff = std::abs(facet.vector[0].y - facet.vector[1].y);
             float zDiff = std::abs(facet.vector[0].z - facet.vector[1].z);
@@ -227,29 +280,61 @@ void StlFile::computeStats()
             p0 = facet.vector[0];
         }
 
-        for (int j = 0; j < 3; j++)
-        {
-            this->stats.max.x = std::max(this->stats.max.x, facet.vector[j].x);
-            this->stats.max.y = std::max(this->stats.max.y, facet.vector[j].y);
-            this->stats.max.z = std::max(this->stats.max.z, facet.vector[j].z);
-            this->stats.min.x = std::min(this->stats.min.x, facet.vector[j].x);
-            this->stats.min.y = std::min(this->stats.min.y, facet.vector[j].y);
-            this->stats.min.z = std::min(this->stats.min.z, facet.vector[j].z);
-        }
-
-        float area = this->getArea(facet);
-        surface += area;
+        parallelFor(0, count, BLOCK_FACETS, [&](size_t b, size_t e) {
+            PartialStats &partial = partials[(first + b) / BLOCK_FACETS];
+            partial.max = facets[b].vector[0];
+            partial.min = facets[b].vector[0];
+            for (size_t i = b; i < e; i++)
+            {
+                Facet &facet = facets[i];
+                for (int j = 0; j < 3; j++)
+                {
+                    partial.max.x = std::max(partial.max.x, facet.vector[j].x);
+                    partial.max.y = std::max(partial.max.y, facet.vector[j].y);
+                    partial.max.z = std::max(partial.max.z, facet.vector[j].z);
+                    partial.min.x = std::min(partial.min.x, facet.vector[j].x);
+                    partial.min.y = std::min(partial.min.y, facet.vector[j].y);
+                    partial.min.z = std::min(partial.min.z, facet.vector[j].z);
+                    vectors[3 * (first + i) + j] = facet.vector[j];
+                }
 
-        Vector p;
-        p.x = facet.vector[0].x - p0.x;
-        p.y = facet.vector[0].y - p0.y;
-        p.z = facet.vector[0].z - p0.z;
-        float height = facet.normal.x * p.x + facet.normal.y * p.y + facet.normal.z * p.z;
-        volume += (area * height) / 3.0f;
+                float area = this->getArea(facet);
+                partial.surface += area;
+                partial.moment += area * (facet.normal.x * facet.vector[0].x +
+                                          facet.normal.y * facet.vector[0].y +
+                                          facet.normal.z * facet.vector[0].z);
+                partial.weightedNormal[0] += area * facet.normal.x;
+                partial.weightedNormal[1] += area * facet.normal.y;
+                partial.weightedNormal[2] += area * facet.normal.z;
+            }
+        });
+    }
 
+    double surface = 0.0;
+    double moment = 0.0;
+    double weightedNormal[3] = {0.0, 0.0, 0.0};
+    for (int k = 0; k < numBlocks; k++)
+    {
+        const PartialStats &partial = partials[k];
+        if (k == 0)
+        {
+            this->stats.max = partial.max;
+            this->stats.min = partial.min;
+        }
+        this->stats.max.x = std::max(this->stats.max.x, partial.max.x);
+        this->stats.max.y = std::max(this->stats.max.y, partial.max.y);
+        this->stats.max.z = std::max(this->stats.max.z, partial.max.z);
+        this->stats.min.x = std::min(this->stats.min.x, partial.min.x);
+        this->stats.min.y = std::min(this->stats.min.y, partial.min.y);
+        this->stats.min.z = std::min(this->stats.min.z, partial.min.z);
+        surface += partial.surface;
+        moment += partial.moment;
         for (int j = 0; j < 3; j++)
-            vectors.push_back(facet.vector[j]);
+            weightedNormal[j] += partial.weightedNormal[j];
     }
+    // Sum over the facets of area * (normal . (v0 - p0)) / 3.
+    double volume = (moment - weightedNormal[0] * p0.x - weightedNormal[1] * p0.y -
+                     weightedNormal[2] * p0.z) / 3.0;
 
     this->stats.size.x = this->stats.max.x - this->stats.min.x;
     this->stats.size.y = this->stats.max.y - this->stats.min.y;
@@ -259,11 +344,11 @@ void StlFile::computeStats()
         this->stats.size.y * this->stats.size.y +
         this->stats.size.z * this->stats.size.z);
 
-    ::std::sort(vectors.begin(), vectors.end(), compareVectors);
+    parallelSort(vectors.begin(), vectors.end(), compareVectors);
     auto last = ::std::unique(vectors.begin(), vectors.end(), equalVectors);
     this->stats.numPoints = static_cast<int>(last - vectors.begin());
-    this->stats.surface = surface > 0 ? surface : -surface;
-    this->stats.volume  = volume  > 0 ? volume  : -volume;
+    this->stats.surface = static_cast<float>(surface > 0 ? surface : -surface);
+    this->stats.volume  = static_cast<float>(volume  > 0 ? volume  : -volume);
 }
 
 int StlFile::readIntFromBytes(::std::ifstream& file)
@@ -297,17 +382,6 @@ void StlFile::writeBytesFromInt(::std::ofstream& file, int valueIn)
     file.write(reinterpret_cast<char*>(&newValue), sizeof(newValue));
 }
 
-void StlFile::writeBytesFromFloat(::std::ofstream& file, float valueIn)
-{
-    union { float floatValue; char charValue[4]; } value;
-    value.floatValue = valueIn;
-    int newValue  = value.charValue[0] & 0xFF;
-    newValue |= (value.charValue[1] & 0xFF) << 0x08;
-    newValue |= (value.charValue[2] & 0xFF) << 0x10;
-    newValue |= (value.charValue[3] & 0xFF) << 0x18;
-    file.write(reinterpret_cast<char*>(&newValue), sizeof(newValue));
-}
-
 void StlFile::writeBinary(const ::std::string& fileName)
 {
     ::std::ofstream fileOut(fileName.c_str(), ::std::ios::out | ::std::ios::binary);
@@ -317,20 +391,19 @@ void StlFile::writeBinary(const ::std::string& fileName)
             fileOut.put(0);
         writeBytesFromInt(fileOut, this->stats.numFacets);
         this->reset();
-        for (int i = 0; i < this->stats.numFacets; i++)
+        ::std::vector<Facet> facets;
+        ::std::vector<char> buffer;
+        for (int first = 0; first < this->stats.numFacets; first += BATCH_FACETS)
         {
-            Facet facet = getNextFacet();
-            writeBytesFromFloat(fileOut, facet.normal.x);
-            writeBytesFromFloat(fileOut, facet.normal.y);
-            writeBytesFromFloat(fileOut, facet.normal.z);
-            for (int j = 0; j < 3; j++)
-            {
-                writeBytesFromFloat(fileOut, facet.vector[j].x);
-                writeBytesFromFloat(fileOut, facet.vector[j].y);
-                writeBytesFromFloat(fileOut, facet.vector[j].z);
-            }
-            fileOut << facet.extra[0];
-            fileOut << facet.extra[1];
+            const int count = ::std::min(BATCH_FACETS, this->stats.numFacets - first);
+            facets.resize(count);
+            this->readFacets(first, count, facets.data());
+            buffer.resize(static_cast<size_t>(count) * SIZE_OF_FACET);
+            parallelFor(0, count, BLOCK_FACETS, [&](size_t b, size_t e) {
+                for (size_t i = b; i < e; i++)
+                    encodeFacet(facets[i], buffer.data() + i * SIZE_OF_FACET);
+            });
+            fileOut.write(buffer.data(), buffer.size());
         }
         fileOut.close();
     }
@@ -344,23 +417,28 @@ void StlFile::writeBinary(const ::std::string& fileName)
 void StlFile::writeAscii(const ::std::string& fileName)
 {
     ::std::ofstream fileOut(fileName.c_str(), ::std::ios::out);
-    fileOut.setf(::std::ios::scientific);
-    fileOut.precision(8);
     if (fileOut.is_open())
     {
         this->reset();
         fileOut << "solid" << ::std::endl;
-        for (int i = 0; i < this->stats.numFacets; i++)
+        ::std::vector<Facet> facets;
+        ::std::vector<::std::string> blocks;
+        for (int first = 0; first < this->stats.numFacets; first += BATCH_FACETS)
         {
-            Facet facet = getNextFacet();
-            fileOut << "  facet normal " << facet.normal.x << " "
-                    << facet.normal.y << " " << facet.normal.z << ::std::endl;
-            fileOut << "    outer loop" << ::std::endl;
-            for (int j = 0; j < 3; j++)
-                fileOut << "      vertex " << facet.vector[j].x << " "
-                        << facet.vector[j].y << " " << facet.vector[j].z << ::std::endl;
-            fileOut << "    endloop" << ::std::endl;
-            fileOut << "  endfacet" << ::std::endl;
+            const int count = ::std::min(BATCH_FACETS, this->stats.numFacets - first);
+            facets.resize(count);
+            this->readFacets(first, count, facets.data());
+            blocks.assign((count + BLOCK_FACETS - 1) / BLOCK_FACETS, ::std::string());
+            parallelFor(0, blocks.size(), 1, [&](size_t b, size_t e) {
+                for (size_t k = b; k < e; k++)
+                {
+                    const int end = ::std::min(count, static_cast<int>(k + 1) * BLOCK_FACETS);
+                    for (int i = static_cast<int>(k) * BLOCK_FACETS; i < end; i++)
+                        formatFacet(facets[i], blocks[k]);
+                }
+            });
+            for (const ::std::string &block : blocks)
+                fileOut << block;
         }
         fileOut << "endsolid" << ::std::endl;
         fileOut.close();
@@ -384,6 +462,75 @@ static bool equalVectors(Vector i, Vector j)
     return i.x == j.x && i.y == j.y && i.z == j.z;
 }
 
+static float decodeFloat(const char *bytes)
+{
+    union { int intValue; float floatValue; } value;
+    value.intValue  =  bytes[0] & 0xFF;
+    value.intValue |= (bytes[1] & 0xFF) << 0x08;
+    value.intValue |= (bytes[2] & 0xFF) << 0x10;
+    value.intValue |= (bytes[3] & 0xFF) << 0x18;
+    return value.floatValue;
+}
+
+static void encodeFloat(float valueIn, char *bytes)
+{
+    union { float floatValue; int intValue; } value;
+    value.floatValue = valueIn;
+    bytes[0] = static_cast<char>(value.intValue & 0xFF);
+    bytes[1] = static_cast<char>((value.intValue >> 0x08) & 0xFF);
+    bytes[2] = static_cast<char>((value.intValue >> 0x10) & 0xFF);
+    bytes[3] = static_cast<char>((value.intValue >> 0x18) & 0xFF);
+}
+
+static void decodeFacet(const char *bytes, StlFile::Facet &facet)
+{
+    facet.normal.x = decodeFloat(bytes);
+    facet.normal.y = decodeFloat(bytes + 4);
+    facet.normal.z = decodeFloat(bytes + 8);
+    for (int i = 0; i < 3; i++)
+    {
+        facet.vector[i].x = decodeFloat(bytes + 12 + 12 * i);
+        facet.vector[i].y = decodeFloat(bytes + 16 + 12 * i);
+        facet.vector[i].z = decodeFloat(bytes + 20 + 12 * i);
+    }
+    facet.extra[0] = bytes[48];
+    facet.extra[1] = bytes[49];
+}
+
+static void encodeFacet(const StlFile::Facet &facet, char *bytes)
+{
+    encodeFloat(facet.normal.x, bytes);
+    encodeFloat(facet.normal.y, bytes + 4);
+    encodeFloat(facet.normal.z, bytes + 8);
+    for (int i = 0; i < 3; i++)
+    {
+        encodeFloat(facet.vector[i].x, bytes + 12 + 12 * i);
+        encodeFloat(facet.vector[i].y, bytes + 16 + 12 * i);
+        encodeFloat(facet.vector[i].z, bytes + 20 + 12 * i);
+    }
+    bytes[48] = facet.extra[0];
+    bytes[49] = facet.extra[1];
+}
+
+// Append facet in the ASCII syntax. "%.8e" matches std::scientific with a
+// precision of 8.
+static void formatFacet(const StlFile::Facet &facet, ::std::string &out)
+{
+    char line[128];
+    snprintf(line, sizeof(line), "  facet normal %.8e %.8e %.8e\n",
+             facet.normal.x, facet.normal.y, facet.normal.z);
+    out += line;
+    out += "    outer loop\n";
+    for (int j = 0; j < 3; j++)
+    {
+        snprintf(line, sizeof(line), "      vertex %.8e %.8e %.8e\n",
+                 facet.vector[j].x, facet.vector[j].y, facet.vector[j].z);
+        out += line;
+    }
+    out += "    endloop\n";
+    out += "  endfacet\n";
+}
+
 float StlFile::getArea(Facet& facet)
 {
     float normal[3];
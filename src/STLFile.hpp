@@ -71,8 +71,13 @@ class StlFile
     void close();
     void setFormat(const int format);
     Stats getStats() const { return stats; };
+    ::std::string getWarning() const { return warning; };
     void reset();
     Facet getNextFacet();
+    // Read _count facets starting at facet _first. Binary files are read in
+    // parallel from independent streams. ASCII files can only be read in
+    // order: _first must be the next facet since reset().
+    void readFacets(int _first, int _count, Facet *_facets);
 
  private:
     void initialize(const ::std::string&);
@@ -80,14 +85,15 @@ class StlFile
     int readIntFromBytes(::std::ifstream&);
     float readFloatFromBytes(::std::ifstream&);
     void writeBytesFromInt(::std::ofstream&, int);
-    void writeBytesFromFloat(::std::ofstream& file, float);
     void writeBinary(const ::std::string&);
     void writeAscii(const ::std::string&);
     float getArea(Facet &facet);
     void calculateNormal(float normal[], Facet &facet);
     void normalizeVector(float v[]);
     ::std::ifstream fileIn;
+    ::std::string fileName;
     Stats stats;
+    ::std::string warning;  // non-fatal problem found by open()
     Format inputType;  // format of the source file; never changed by setFormat()
 };
 
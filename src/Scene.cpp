@@ -0,0 +1,144 @@
+// Copyright (C) 2009-2015 Olivier Crave
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "Scene.hpp"
+#include "ResidencyManager.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace stlviewer;
+
+Scene::Scene(const QVector<QSharedPointer<MeshResource>> &_parts)
+    : stats()
+    , geometries(nullptr)
+{
+    for (int i = 0; i < _parts.size(); ++i)
+    {
+        // Spread the hues by the golden angle so that neighbours differ.
+        const QColor color = QColor::fromHsvF(std::fmod(0.6 + i * 0.618034, 1.0),
+                                              0.35, 0.85);
+        Part part;
+        part.mesh = _parts[i];
+        part.color = QVector3D(color.redF(), color.greenF(), color.blueF());
+        part.visible = true;
+        this->parts.append(part);
+
+        const StlFile::Stats partStats = part.mesh->getStats();
+        if (i == 0)
+        {
+            this->stats = partStats;
+            this->stats.header.clear();
+            continue;
+        }
+        this->stats.numFacets += partStats.numFacets;
+        this->stats.numPoints += partStats.numPoints;
+        this->stats.max.x = std::max(this->stats.max.x, partStats.max.x);
+        this->stats.max.y = std::max(this->stats.max.y, partStats.max.y);
+        this->stats.max.z = std::max(this->stats.max.z, partStats.max.z);
+        this->stats.min.x = std::min(this->stats.min.x, partStats.min.x);
+        this->stats.min.y = std::min(this->stats.min.y, partStats.min.y);
+        this->stats.min.z = std::min(this->stats.min.z, partStats.min.z);
+        this->stats.shortestEdge = std::min(this->stats.shortestEdge,
+                                            partStats.shortestEdge);
+        this->stats.volume += partStats.volume;
+        this->stats.surface += partStats.surface;
+    }
+
+    this->stats.size.x = this->stats.max.x - this->stats.min.x;
+    this->stats.size.y = this->stats.max.y - this->stats.min.y;
+    this->stats.size.z = this->stats.max.z - this->stats.min.z;
+    this->stats.boundingDiameter = std::sqrt(
+        this->stats.size.x * this->stats.size.x +
+        this->stats.size.y * this->stats.size.y +
+        this->stats.size.z * this->stats.size.z);
+}
+
+Scene::~Scene()
+{
+    ResidencyManager::instance()->remove(this);
+    delete this->geometries;
+}
+
+void Scene::setPartTransform(int _index, const QMatrix4x4 &_transform)
+{
+    this->parts[_index].transform = _transform;
+    this->updatePart(_index);
+}
+
+void Scene::setPartColor(int _index, const QVector3D &_color)
+{
+    this->parts[_index].color = _color;
+    this->updatePart(_index);
+}
+
+void Scene::setPartVisible(int _index, bool _visible)
+{
+    this->parts[_index].visible = _visible;
+    this->updatePart(_index);
+}
+
+void Scene::updatePart(int _index)
+{
+    if (this->geometries && _index < this->geometries->getPartCount())
+    {
+        const Part &part = this->parts[_index];
+        this->geometries->setPartAttributes(_index, part.transform, part.color,
+                                            part.visible);
+    }
+}
+
+GeometryEngine *Scene::geometry(bool _withNormals)
+{
+    if (!this->geometries || !this->geometries->isResident() ||
+        this->geometries->hasNormals() != _withNormals)
+    {
+        if (!this->geometries)
+            this->geometries = new GeometryEngine;
+
+        std::vector<StlFile *> files;
+        files.reserve(this->parts.size());
+        for (const Part &part : this->parts)
+            files.push_back(&part.mesh->stlFile());
+        this->geometries->initGeometry(files, _withNormals);
+        for (int i = 0; i < this->parts.size(); ++i)
+            this->updatePart(i);
+    }
+    ResidencyManager::instance()->touch(this);
+    return this->geometries;
+}
+
+void Scene::releaseVertexArray()
+{
+    if (this->geometries)
+        this->geometries->releaseVertexArray();
+}
+
+qint64 Scene::residentBytes() const
+{
+    return this->geometries ? this->geometries->residentBytes() : 0;
+}
+
+void Scene::releaseBuffers()
+{
+    if (this->geometries)
+        this->geometries->releaseBuffers();
+}
@@ -0,0 +1,101 @@
+// Copyright (C) 2009-2015 Olivier Crave
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef _SCENE_HPP
+#define _SCENE_HPP
+
+#include "qt.hpp"
+#include "MeshResource.hpp"
+#include "GpuResource.hpp"
+
+namespace stlviewer
+{
+
+/// \brief Several meshes shown together in one view, e.g. the parts of an
+/// assembly.
+///
+/// The parts are packed into a single vertex buffer and drawn with one
+/// multi-draw call, so the cost of a frame does not grow with the number of
+/// parts. Each part has its own transform, color and visibility. The parts
+/// stay registered with the MeshManager, so a part that is also open in a
+/// window of its own is parsed only once.
+class Scene : public GpuResource
+{
+    /// \brief Create a scene of _parts, colored from a fixed palette.
+    public: explicit Scene(const QVector<QSharedPointer<MeshResource>> &_parts);
+
+    public: ~Scene();
+
+    public: int getPartCount() const { return this->parts.size(); }
+
+    public: QSharedPointer<MeshResource> getPart(int _index) const
+            { return this->parts[_index].mesh; }
+
+    public: QMatrix4x4 getPartTransform(int _index) const
+            { return this->parts[_index].transform; }
+
+    public: void setPartTransform(int _index, const QMatrix4x4 &_transform);
+
+    public: QVector3D getPartColor(int _index) const
+            { return this->parts[_index].color; }
+
+    public: void setPartColor(int _index, const QVector3D &_color);
+
+    public: bool isPartVisible(int _index) const
+            { return this->parts[_index].visible; }
+
+    public: void setPartVisible(int _index, bool _visible);
+
+    /// \brief Return the stats of all parts together: counts, surface and
+    /// volume are summed and the bounding box is the union of the part
+    /// boxes. Part transforms are not taken into account.
+    public: StlFile::Stats getStats() const Q_DECL_OVERRIDE { return this->stats; }
+
+    public: GeometryEngine *geometry(bool _withNormals) Q_DECL_OVERRIDE;
+
+    public: void releaseVertexArray() Q_DECL_OVERRIDE;
+
+    public: qint64 residentBytes() const Q_DECL_OVERRIDE;
+
+    public: void releaseBuffers() Q_DECL_OVERRIDE;
+
+    private: Q_DISABLE_COPY(Scene)
+
+    /// \brief Pass the attributes of part _index to the geometry.
+    private: void updatePart(int _index);
+
+    private: struct Part
+    {
+        QSharedPointer<MeshResource> mesh;
+        QMatrix4x4 transform;
+        QVector3D color;
+        bool visible;
+    };
+
+    private: QVector<Part> parts;
+
+    private: StlFile::Stats stats;
+
+    private: GeometryEngine *geometries;
+};
+
+}
+
+#endif
@@ -1,20 +1,53 @@
 #include <QDialogButtonBox>
 #include <QVBoxLayout>
+#include <QHBoxLayout>
 #include <QCheckBox>
+#include <QLabel>
+#include <QSpinBox>
 
 #include "SettingsDialog.hpp"
 
 SettingsDialog::SettingsDialog(QWidget *parent)
      :   QDialog(parent)
      ,   reverseYAxisCheckBox(new QCheckBox(tr("Reverse Y-Axis"), this))
+     ,   derivedNormalsCheckBox(new QCheckBox(tr("Compute flat normals on the GPU"), this))
+     ,   videoMemoryBudgetSpinBox(new QSpinBox(this))
+     ,   workerThreadsSpinBox(new QSpinBox(this))
 {
     QVBoxLayout *dialogLayout = new QVBoxLayout(this);
 
     // Populate checkboxes
     reverseYAxisCheckBox->setChecked(false);
+    derivedNormalsCheckBox->setChecked(true);
+    derivedNormalsCheckBox->setToolTip(tr("Ignore the normals stored in the file and "
+                                          "derive them from the facets. Uses less "
+                                          "video memory."));
+
+    // Populate spin boxes
+    videoMemoryBudgetSpinBox->setRange(0, 65536);
+    videoMemoryBudgetSpinBox->setSingleStep(256);
+    videoMemoryBudgetSpinBox->setSuffix(tr(" MB"));
+    videoMemoryBudgetSpinBox->setSpecialValueText(tr("Unlimited"));
+    videoMemoryBudgetSpinBox->setToolTip(tr("Meshes of windows that were not drawn "
+                                            "recently are removed from video memory "
+                                            "when this budget is exceeded."));
+    workerThreadsSpinBox->setRange(0, 256);
+    workerThreadsSpinBox->setSpecialValueText(tr("Automatic"));
+    workerThreadsSpinBox->setToolTip(tr("Number of threads used to load, analyze and "
+                                        "save meshes. Automatic uses one per processor "
+                                        "core."));
  
     // Add widgets to layout
     dialogLayout->addWidget(reverseYAxisCheckBox);
+    dialogLayout->addWidget(derivedNormalsCheckBox);
+    QHBoxLayout *videoMemoryBudgetLayout = new QHBoxLayout;
+    videoMemoryBudgetLayout->addWidget(new QLabel(tr("Video memory budget:"), this));
+    videoMemoryBudgetLayout->addWidget(videoMemoryBudgetSpinBox);
+    dialogLayout->addLayout(videoMemoryBudgetLayout);
+    QHBoxLayout *workerThreadsLayout = new QHBoxLayout;
+    workerThreadsLayout->addWidget(new QLabel(tr("Worker threads:"), this));
+    workerThreadsLayout->addWidget(workerThreadsSpinBox);
+    dialogLayout->addLayout(workerThreadsLayout);
 
     // Add standard buttons to layout
     QDialogButtonBox *buttonBox = new QDialogButtonBox(this);
@@ -35,9 +68,13 @@ SettingsDialog::~SettingsDialog()
 
 }
 
-void SettingsDialog::exec(bool yAxisReversed)
+void SettingsDialog::exec(bool yAxisReversed, bool derivedNormals, int videoMemoryBudget,
+                          int workerThreads)
 {
     reverseYAxisCheckBox->setChecked(yAxisReversed);
+    derivedNormalsCheckBox->setChecked(derivedNormals);
+    videoMemoryBudgetSpinBox->setValue(videoMemoryBudget);
+    workerThreadsSpinBox->setValue(workerThreads);
     QDialog::exec();
 }
 
@@ -45,3 +82,18 @@ bool SettingsDialog::isYAxisReversed() const
 {
     return reverseYAxisCheckBox->isChecked();
 }
+
+bool SettingsDialog::isDerivedNormalsModeActivated() const
+{
+    return derivedNormalsCheckBox->isChecked();
+}
+
+int SettingsDialog::getVideoMemoryBudget() const
+{
+    return videoMemoryBudgetSpinBox->value();
+}
+
+int SettingsDialog::getWorkerThreads() const
+{
+    return workerThreadsSpinBox->value();
+}
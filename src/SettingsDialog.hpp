@@ -24,6 +24,7 @@
 #include <QDialog>
 
 class QCheckBox;
+class QSpinBox;
 
 /**
  * Dialog used to control settings such as the audio input / output device
@@ -38,12 +39,19 @@ class SettingsDialog : public QDialog
     SettingsDialog(QWidget *parent = 0);
     ~SettingsDialog();
 
-    void exec(bool yAxisReversed);
+    void exec(bool yAxisReversed, bool derivedNormals, int videoMemoryBudget,
+              int workerThreads);
     bool isYAxisReversed() const;
+    bool isDerivedNormalsModeActivated() const;
+    int getVideoMemoryBudget() const;
+    int getWorkerThreads() const;
 
  private:
 
     QCheckBox *reverseYAxisCheckBox;
+    QCheckBox *derivedNormalsCheckBox;
+    QSpinBox *videoMemoryBudgetSpinBox;
+    QSpinBox *workerThreadsSpinBox;
 
  };
 
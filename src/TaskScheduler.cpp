@@ -0,0 +1,269 @@
+// Copyright (C) 2009-2015 Olivier Crave
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "TaskScheduler.hpp"
+
+#include <chrono>
+
+using namespace stlviewer;
+
+// Index of the worker running on this thread, or -1.
+static thread_local int currentWorker = -1;
+
+TaskScheduler::TaskScheduler()
+    : pending(0)
+    , stopping(false)
+{
+    this->start(0);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    this->stop();
+}
+
+TaskScheduler *TaskScheduler::instance()
+{
+    static TaskScheduler scheduler;
+    return &scheduler;
+}
+
+void TaskScheduler::setWorkerCount(int _count)
+{
+    this->stop();
+    this->start(_count);
+}
+
+int TaskScheduler::getWorkerCount() const
+{
+    return static_cast<int>(this->workers.size());
+}
+
+void TaskScheduler::start(int _count)
+{
+    if (_count <= 0)
+        _count = static_cast<int>(::std::thread::hardware_concurrency());
+    _count = ::std::max(_count, 1);
+
+    this->stopping = false;
+    for (int i = 0; i < _count; ++i)
+        this->workers.emplace_back(new Worker);
+    for (int i = 0; i < _count; ++i)
+        this->workers[i]->thread = ::std::thread(&TaskScheduler::workerLoop, this, i);
+}
+
+void TaskScheduler::stop()
+{
+    {
+        ::std::lock_guard<::std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wakeUp.notify_all();
+    for (const auto &worker : this->workers)
+        worker->thread.join();
+
+    // Keep what the workers left queued for the next ones.
+    ::std::lock_guard<::std::mutex> lock(this->mutex);
+    for (const auto &worker : this->workers)
+    {
+        for (Task &task : worker->tasks)
+            this->injected.push_back(::std::move(task));
+    }
+    this->workers.clear();
+}
+
+void TaskScheduler::submit(Task _task)
+{
+    if (currentWorker >= 0)
+    {
+        Worker &worker = *this->workers[currentWorker];
+        ::std::lock_guard<::std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(::std::move(_task));
+    }
+
+    // Counted under the lock so that a worker going to sleep cannot miss it.
+    {
+        ::std::lock_guard<::std::mutex> lock(this->mutex);
+        if (currentWorker < 0)
+            this->injected.push_back(::std::move(_task));
+        ++this->pending;
+    }
+    this->wakeUp.notify_one();
+}
+
+bool TaskScheduler::runPendingTask()
+{
+    Task task;
+    if (!this->pop(currentWorker, task))
+        return false;
+    task();
+    return true;
+}
+
+bool TaskScheduler::pop(int _index, Task &_task)
+{
+    if (_index >= 0)
+    {
+        Worker &worker = *this->workers[_index];
+        ::std::lock_guard<::std::mutex> lock(worker.mutex);
+        if (!worker.tasks.empty())
+        {
+            _task = ::std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+            --this->pending;
+            return true;
+        }
+    }
+
+    {
+        ::std::lock_guard<::std::mutex> lock(this->mutex);
+        if (!this->injected.empty())
+        {
+            _task = ::std::move(this->injected.front());
+            this->injected.pop_front();
+            --this->pending;
+            return true;
+        }
+    }
+
+    const int count = static_cast<int>(this->workers.size());
+    for (int i = 1; i <= count; ++i)
+    {
+        const int victim = (_index + i + count) % count;
+        if (victim == _index)
+            continue;
+        Worker &worker = *this->workers[victim];
+        ::std::lock_guard<::std::mutex> lock(worker.mutex);
+        if (!worker.tasks.empty())
+        {
+            _task = ::std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+            --this->pending;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::workerLoop(int _index)
+{
+    currentWorker = _index;
+    for (;;)
+    {
+        Task task;
+        if (this->pop(_index, task))
+        {
+            task();
+            continue;
+        }
+
+        ::std::unique_lock<::std::mutex> lock(this->mutex);
+        this->wakeUp.wait(lock, [this]() {
+            return this->stopping || this->pending.load() > 0;
+        });
+        if (this->stopping)
+            break;
+    }
+    currentWorker = -1;
+}
+
+TaskGroup::TaskGroup(const CancellationToken &_token)
+    : state(::std::make_shared<State>())
+    , cancellation(_token)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    try
+    {
+        this->wait();
+    }
+    catch (...)
+    {
+    }
+}
+
+void TaskGroup::run(TaskScheduler::Task _task)
+{
+    {
+        ::std::lock_guard<::std::mutex> lock(this->state->mutex);
+        ++this->state->pending;
+    }
+
+    ::std::shared_ptr<State> groupState = this->state;
+    CancellationToken token = this->cancellation;
+    TaskScheduler::instance()->submit([groupState, token, _task]() {
+        bool skip = token.isCancelled();
+        if (!skip)
+        {
+            ::std::lock_guard<::std::mutex> lock(groupState->mutex);
+            skip = static_cast<bool>(groupState->error);
+        }
+        if (!skip)
+        {
+            try
+            {
+                _task();
+            }
+            catch (...)
+            {
+                ::std::lock_guard<::std::mutex> lock(groupState->mutex);
+                if (!groupState->error)
+                    groupState->error = ::std::current_exception();
+            }
+        }
+
+        ::std::lock_guard<::std::mutex> lock(groupState->mutex);
+        if (--groupState->pending == 0)
+            groupState->done.notify_all();
+    });
+}
+
+void TaskGroup::wait()
+{
+    TaskScheduler *scheduler = TaskScheduler::instance();
+    for (;;)
+    {
+        {
+            ::std::lock_guard<::std::mutex> lock(this->state->mutex);
+            if (this->state->pending == 0)
+                break;
+        }
+
+        // Help instead of blocking a worker. The timeout catches tasks
+        // queued after the pool looked empty.
+        if (!scheduler->runPendingTask())
+        {
+            ::std::unique_lock<::std::mutex> lock(this->state->mutex);
+            this->state->done.wait_for(lock, ::std::chrono::milliseconds(1), [this]() {
+                return this->state->pending == 0;
+            });
+        }
+    }
+
+    ::std::exception_ptr error;
+    {
+        ::std::lock_guard<::std::mutex> lock(this->state->mutex);
+        ::std::swap(error, this->state->error);
+    }
+    if (error)
+        ::std::rethrow_exception(error);
+}
@@ -0,0 +1,227 @@
+// Copyright (C) 2009-2015 Olivier Crave
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef _TASKSCHEDULER_HPP
+#define _TASKSCHEDULER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace stlviewer
+{
+
+/// \brief Shared flag used to abandon work that has not started yet.
+///
+/// Copies refer to the same flag, so a token handed to a TaskGroup or to
+/// parallelFor() can be cancelled from any thread.
+class CancellationToken
+{
+    public: CancellationToken()
+        : state(::std::make_shared<::std::atomic<bool>>(false)) {}
+
+    public: void cancel() const { this->state->store(true); }
+
+    public: bool isCancelled() const { return this->state->load(); }
+
+    private: ::std::shared_ptr<::std::atomic<bool>> state;
+};
+
+/// \brief Project-wide pool of worker threads.
+///
+/// Every worker owns a deque. Tasks submitted from a worker go to the back
+/// of its own deque and are taken from there, so nested work stays on the
+/// thread whose caches hold its data. Idle workers steal from the front of
+/// the other deques. Tasks submitted from other threads go to a shared
+/// queue. All parallel code should run here rather than start threads of
+/// its own, so that the machine is never oversubscribed.
+class TaskScheduler
+{
+    public: typedef ::std::function<void()> Task;
+
+    public: static TaskScheduler *instance();
+
+    public: ~TaskScheduler();
+
+    /// \brief Restart the pool with _count workers; 0 means one per
+    /// hardware thread. Waits for the running tasks; queued ones are kept.
+    /// Must not be called from a task.
+    public: void setWorkerCount(int _count);
+
+    public: int getWorkerCount() const;
+
+    /// \brief Queue _task. Prefer TaskGroup, which can wait for it.
+    public: void submit(Task _task);
+
+    /// \brief Run one queued task on the calling thread.
+    /// \return False if no task was queued.
+    public: bool runPendingTask();
+
+    private: TaskScheduler();
+
+    private: TaskScheduler(const TaskScheduler &) = delete;
+
+    private: TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+    private: void start(int _count);
+
+    private: void stop();
+
+    private: void workerLoop(int _index);
+
+    /// \brief Take a task: from the back of worker _index's own deque,
+    /// then from the shared queue, then from the front of another deque.
+    private: bool pop(int _index, Task &_task);
+
+    private: struct Worker
+    {
+        ::std::mutex mutex;
+        ::std::deque<Task> tasks;
+        ::std::thread thread;
+    };
+
+    private: ::std::vector<::std::unique_ptr<Worker>> workers;
+
+    /// \brief Protects injected and stopping; pairs with wakeUp.
+    private: ::std::mutex mutex;
+
+    private: ::std::condition_variable wakeUp;
+
+    /// \brief Tasks submitted from threads that are not workers.
+    private: ::std::deque<Task> injected;
+
+    /// \brief Number of queued tasks over all queues.
+    private: ::std::atomic<int> pending;
+
+    private: bool stopping;
+};
+
+/// \brief A set of tasks that can be waited for together.
+///
+/// wait() runs queued tasks on the calling thread until the group is
+/// done, so groups may be nested inside tasks without starving the pool.
+/// The first exception thrown by a task is rethrown by wait(); the tasks
+/// of the group that have not started by then are skipped, as are all of
+/// them once the token is cancelled.
+class TaskGroup
+{
+    public: explicit TaskGroup(const CancellationToken &_token = CancellationToken());
+
+    /// \brief Wait for the tasks; exceptions are dropped.
+    public: ~TaskGroup();
+
+    public: void run(TaskScheduler::Task _task);
+
+    public: void wait();
+
+    public: const CancellationToken &token() const { return this->cancellation; }
+
+    private: TaskGroup(const TaskGroup &) = delete;
+
+    private: TaskGroup &operator=(const TaskGroup &) = delete;
+
+    private: struct State
+    {
+        ::std::mutex mutex;
+        ::std::condition_variable done;
+        int pending = 0;
+        ::std::exception_ptr error;
+    };
+
+    private: ::std::shared_ptr<State> state;
+
+    private: CancellationToken cancellation;
+};
+
+/// \brief Call _function(first, last) for consecutive ranges of at most
+/// _grain indices covering [_begin, _end), in parallel, and wait for them.
+template <typename Function>
+void parallelFor(::std::size_t _begin, ::std::size_t _end, ::std::size_t _grain,
+                 const Function &_function,
+                 const CancellationToken &_token = CancellationToken())
+{
+    if (_end <= _begin || _token.isCancelled())
+        return;
+    _grain = ::std::max<::std::size_t>(_grain, 1);
+    if (_end - _begin <= _grain)
+    {
+        _function(_begin, _end);
+        return;
+    }
+
+    TaskGroup group(_token);
+    for (::std::size_t first = _begin; first < _end; first += _grain)
+    {
+        const ::std::size_t last = ::std::min(_end, first + _grain);
+        group.run([&_function, first, last]() { _function(first, last); });
+    }
+    group.wait();
+}
+
+/// \brief Sort [_first, _last) with one block per worker, then merge the
+/// sorted blocks pairwise, each round in parallel.
+template <typename Iterator, typename Compare>
+void parallelSort(Iterator _first, Iterator _last, Compare _less)
+{
+    const ::std::size_t MIN_BLOCK_SIZE = 1 << 15;
+    const ::std::size_t size = static_cast<::std::size_t>(_last - _first);
+    const ::std::size_t blocks = ::std::min<::std::size_t>(
+        TaskScheduler::instance()->getWorkerCount(), size / MIN_BLOCK_SIZE);
+    if (blocks < 2)
+    {
+        ::std::sort(_first, _last, _less);
+        return;
+    }
+
+    ::std::vector<::std::size_t> bounds(blocks + 1);
+    for (::std::size_t i = 0; i <= blocks; ++i)
+        bounds[i] = size * i / blocks;
+
+    parallelFor(0, blocks, 1, [&](::std::size_t _b, ::std::size_t _e) {
+        for (::std::size_t i = _b; i < _e; ++i)
+            ::std::sort(_first + bounds[i], _first + bounds[i + 1], _less);
+    });
+
+    for (::std::size_t width = 1; width < blocks; width *= 2)
+    {
+        const ::std::size_t pairs = (blocks + 2 * width - 1) / (2 * width);
+        parallelFor(0, pairs, 1, [&](::std::size_t _b, ::std::size_t _e) {
+            for (::std::size_t i = _b; i < _e; ++i)
+            {
+                const ::std::size_t lo = bounds[2 * i * width];
+                const ::std::size_t mid = bounds[::std::min(blocks, (2 * i + 1) * width)];
+                const ::std::size_t hi = bounds[::std::min(blocks, (2 * i + 2) * width)];
+                ::std::inplace_merge(_first + lo, _first + mid, _first + hi, _less);
+            }
+        });
+    }
+}
+
+}
+
+#endif
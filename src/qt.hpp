@@ -5,6 +5,7 @@
 
 #include <QtGui>
 #include <QPoint>
+#include <QTimer>
 #include <QFrame>
 #include <QCheckBox>
 #include <QGroupBox>